@@ -0,0 +1,232 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef FACEDETECTOR_H
+#define FACEDETECTOR_H
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <net.h>
+
+#include "nms.h"
+
+// one face in padded input pixels while decoding, in image pixels once detect_faces returns
+struct DetectorProposal
+{
+    cv::Rect_<float> rect;
+    float prob;
+    // empty when the model has no keypoint head
+    std::vector<cv::Point2f> pts;
+};
+
+// per frame vectors of detect_faces, kept next to the inference context that runs it so
+// steady state frames reuse their capacity, one scratch serves one call at a time
+struct DetectorScratch
+{
+    // anchor indices passing the score threshold, for backends that scan the scores first
+    std::vector<int> indices;
+    std::vector<DetectorProposal> proposals;
+    std::vector<int> picked;
+    std::vector<int> cluster_of;
+    NmsScratch nms;
+    // score sum of each cluster while blending
+    std::vector<float> cluster_weights;
+};
+
+// what differs between detector networks, the letterbox, nms and unletterbox around them are shared
+//
+// backends are immutable once created, decode may run on several threads at once
+class DetectorBackend
+{
+public:
+    virtual ~DetectorBackend() {}
+
+    // for logs, so throughput can be compared between backends
+    virtual const char* name() const = 0;
+
+    virtual const char* input_name() const = 0;
+
+    // every padded input side is a multiple of this, the coarsest stride of the net
+    virtual int pad_multiple() const = 0;
+
+    // normalization of 0-255 pixel values into the net input
+    virtual const float* mean_values() const = 0;
+    virtual const float* norm_values() const = 0;
+
+    // extract the output blobs of an extractor fed with in_pad and append every proposal scoring
+    // above prob_threshold to scratch.proposals, the other scratch vectors are free to use
+    virtual void decode(ncnn::Extractor& ex, const ncnn::Mat& in_pad, float prob_threshold, DetectorScratch& scratch) const = 0;
+};
+
+// size of the unpadded detector input with the long side at target_size, returns the scale from image pixels
+static inline float letterbox_scale(int img_w, int img_h, int target_size, int& w, int& h)
+{
+    float scale = 1.f;
+    w = img_w;
+    h = img_h;
+    if (w > h)
+    {
+        scale = (float)target_size / w;
+        w = target_size;
+        h = h * scale;
+    }
+    else
+    {
+        scale = (float)target_size / h;
+        h = target_size;
+        w = w * scale;
+    }
+
+    return scale;
+}
+
+static inline bool proposal_greater(const DetectorProposal& a, const DetectorProposal& b)
+{
+    return a.prob > b.prob;
+}
+
+// score weighted mean of box and keypoints over each cluster, the cluster keeps its best score
+// weights is scratch for the per cluster score sums
+static inline void blend_proposal_clusters(const std::vector<DetectorProposal>& proposals, const std::vector<int>& picked, const std::vector<int>& cluster_of,
+                                           std::vector<float>& weights, std::vector<DetectorProposal>& faces)
+{
+    const int count = picked.size();
+
+    faces.resize(count);
+    weights.assign(count, 0.f);
+    for (int k = 0; k < count; k++)
+    {
+        DetectorProposal& face = faces[k];
+        face = proposals[picked[k]];
+        face.rect = cv::Rect_<float>(0.f, 0.f, 0.f, 0.f);
+        for (size_t j = 0; j < face.pts.size(); j++)
+        {
+            face.pts[j] = cv::Point2f(0.f, 0.f);
+        }
+    }
+
+    for (size_t i = 0; i < proposals.size(); i++)
+    {
+        const int k = cluster_of[i];
+        if (k < 0)
+            continue;
+
+        const DetectorProposal& p = proposals[i];
+        DetectorProposal& face = faces[k];
+        const float w = p.prob;
+
+        face.rect.x += p.rect.x * w;
+        face.rect.y += p.rect.y * w;
+        face.rect.width += p.rect.width * w;
+        face.rect.height += p.rect.height * w;
+        for (size_t j = 0; j < face.pts.size(); j++)
+        {
+            face.pts[j].x += p.pts[j].x * w;
+            face.pts[j].y += p.pts[j].y * w;
+        }
+
+        weights[k] += w;
+    }
+
+    for (int k = 0; k < count; k++)
+    {
+        DetectorProposal& face = faces[k];
+        const float inv_w = 1.f / weights[k];
+
+        face.rect.x *= inv_w;
+        face.rect.y *= inv_w;
+        face.rect.width *= inv_w;
+        face.rect.height *= inv_w;
+        for (size_t j = 0; j < face.pts.size(); j++)
+        {
+            face.pts[j].x *= inv_w;
+            face.pts[j].y *= inv_w;
+        }
+    }
+}
+
+// the stages every detector shares, letterbox pad, extract and decode through the backend,
+// bounded sort, hard or weighted nms, then boxes and keypoints back into the img_w x img_h image
+//
+// in is the normalized unpadded input scaled by scale from the image, ex has no input set yet
+// max_faces 0 keeps every face that survives nms
+static inline void detect_faces(const DetectorBackend& backend, ncnn::Extractor& ex, const ncnn::Mat& in, float scale, int img_w, int img_h,
+                                float prob_threshold, float nms_threshold, bool weighted_nms, int max_faces, DetectorScratch& scratch, std::vector<DetectorProposal>& faces)
+{
+    const int multiple = backend.pad_multiple();
+    const int wpad = (in.w + multiple - 1) / multiple * multiple - in.w;
+    const int hpad = (in.h + multiple - 1) / multiple * multiple - in.h;
+    ncnn::Mat in_pad;
+    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
+
+    ex.input(backend.input_name(), in_pad);
+
+    std::vector<DetectorProposal>& proposals = scratch.proposals;
+    proposals.clear();
+    backend.decode(ex, in_pad, prob_threshold, scratch);
+
+    // bounded so a low threshold cannot flood nms
+    const int max_proposals = 512;
+    sort_proposals_descent(proposals, max_proposals, proposal_greater);
+
+    std::vector<int>& picked = scratch.picked;
+    if (weighted_nms)
+    {
+        std::vector<int>& cluster_of = scratch.cluster_of;
+        nms_sorted_clusters(proposals, picked, cluster_of, scratch.nms, nms_threshold, max_faces);
+        blend_proposal_clusters(proposals, picked, cluster_of, scratch.cluster_weights, faces);
+    }
+    else
+    {
+        nms_sorted_bboxes(proposals, picked, scratch.nms, nms_threshold, max_faces);
+
+        faces.resize(picked.size());
+        for (size_t i = 0; i < picked.size(); i++)
+        {
+            faces[i] = proposals[picked[i]];
+        }
+    }
+
+    const float pad_x = wpad / 2;
+    const float pad_y = hpad / 2;
+    const float inv_scale = 1.f / scale;
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        DetectorProposal& face = faces[i];
+
+        // adjust offset to original unpadded, then clip
+        float x0 = (face.rect.x - pad_x) * inv_scale;
+        float y0 = (face.rect.y - pad_y) * inv_scale;
+        float x1 = (face.rect.x + face.rect.width - pad_x) * inv_scale;
+        float y1 = (face.rect.y + face.rect.height - pad_y) * inv_scale;
+
+        x0 = std::max(std::min(x0, (float)(img_w - 1)), 0.f);
+        y0 = std::max(std::min(y0, (float)(img_h - 1)), 0.f);
+        x1 = std::max(std::min(x1, (float)(img_w - 1)), 0.f);
+        y1 = std::max(std::min(y1, (float)(img_h - 1)), 0.f);
+
+        face.rect = cv::Rect_<float>(x0, y0, x1 - x0, y1 - y0);
+
+        for (size_t j = 0; j < face.pts.size(); j++)
+        {
+            face.pts[j].x = (face.pts[j].x - pad_x) * inv_scale;
+            face.pts[j].y = (face.pts[j].y - pad_y) * inv_scale;
+        }
+    }
+}
+
+#endif // FACEDETECTOR_H
@@ -0,0 +1,209 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NMS_H
+#define NMS_H
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+// proposals ordered by score from highest to lowest in place, only the best max_count
+// are kept and ordered when max_count > 0, greater compares two proposals by score
+template<typename T, typename Greater>
+static void sort_proposals_descent(std::vector<T>& objects, int max_count, Greater greater)
+{
+    if (max_count > 0 && (int)objects.size() > max_count)
+    {
+        std::nth_element(objects.begin(), objects.begin() + max_count, objects.end(), greater);
+        objects.resize(max_count);
+    }
+
+    std::sort(objects.begin(), objects.end(), greater);
+}
+
+// boxes sharing a center cell or a neighbouring one are the only ones that can overlap,
+// with few proposals the plain scan over the picked boxes is cheaper than the grid
+static const int nms_bucket_min_proposals = 32;
+
+// per call vectors of the nms functions, owned by the caller so they keep their capacity across frames
+struct NmsScratch
+{
+    std::vector<float> areas;
+    // picked boxes chained per grid cell, cell_head and next hold indices into objects
+    std::vector<int> cell_head;
+    std::vector<int> next;
+};
+
+template<typename T>
+static inline bool nms_suppressed(const T& a, float area_a, const T& b, float area_b, float nms_threshold)
+{
+    const float inter_w = std::min(a.rect.x + a.rect.width, b.rect.x + b.rect.width) - std::max(a.rect.x, b.rect.x);
+    const float inter_h = std::min(a.rect.y + a.rect.height, b.rect.y + b.rect.height) - std::max(a.rect.y, b.rect.y);
+    if (inter_w <= 0.f || inter_h <= 0.f)
+        return false;
+
+    // iou > t without the division
+    const float inter_area = inter_w * inter_h;
+    return inter_area > nms_threshold * (area_a + area_b - inter_area);
+}
+
+// hard nms over proposals already sorted by score from highest to lowest
+//
+// T needs a cv::Rect_<float> rect member, shared by the detectors of both apps
+// max_count 0 keeps every surviving box, otherwise stops after max_count picks
+template<typename T>
+static void nms_sorted_bboxes(const std::vector<T>& objects, std::vector<int>& picked, NmsScratch& scratch, float nms_threshold, int max_count = 0)
+{
+    picked.clear();
+
+    const int n = objects.size();
+    if (n == 0)
+        return;
+
+    std::vector<float>& areas = scratch.areas;
+    areas.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        areas[i] = objects[i].rect.area();
+    }
+
+    if (n < nms_bucket_min_proposals)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            bool keep = true;
+            for (int j = 0; j < (int)picked.size(); j++)
+            {
+                if (nms_suppressed(objects[i], areas[i], objects[picked[j]], areas[picked[j]], nms_threshold))
+                {
+                    keep = false;
+                    break;
+                }
+            }
+
+            if (keep)
+            {
+                picked.push_back(i);
+
+                if ((int)picked.size() == max_count)
+                    break;
+            }
+        }
+
+        return;
+    }
+
+    // grid of square cells as large as the largest box, two boxes can only
+    // overlap when their centers are at most one cell apart on each axis
+    float min_x = objects[0].rect.x;
+    float min_y = objects[0].rect.y;
+    float max_x = min_x;
+    float max_y = min_y;
+    float cell_size = 1.f;
+    for (int i = 0; i < n; i++)
+    {
+        const float cx = objects[i].rect.x + objects[i].rect.width * 0.5f;
+        const float cy = objects[i].rect.y + objects[i].rect.height * 0.5f;
+        min_x = std::min(min_x, cx);
+        min_y = std::min(min_y, cy);
+        max_x = std::max(max_x, cx);
+        max_y = std::max(max_y, cy);
+        cell_size = std::max(cell_size, std::max(objects[i].rect.width, objects[i].rect.height));
+    }
+
+    const int grid_w = (int)((max_x - min_x) / cell_size) + 1;
+    const int grid_h = (int)((max_y - min_y) / cell_size) + 1;
+
+    std::vector<int>& cell_head = scratch.cell_head;
+    std::vector<int>& next = scratch.next;
+    cell_head.assign(grid_w * grid_h, -1);
+    next.assign(n, -1);
+
+    for (int i = 0; i < n; i++)
+    {
+        const T& a = objects[i];
+        const int gx = (int)((a.rect.x + a.rect.width * 0.5f - min_x) / cell_size);
+        const int gy = (int)((a.rect.y + a.rect.height * 0.5f - min_y) / cell_size);
+
+        bool keep = true;
+        for (int y = std::max(gy - 1, 0); keep && y <= std::min(gy + 1, grid_h - 1); y++)
+        {
+            for (int x = std::max(gx - 1, 0); keep && x <= std::min(gx + 1, grid_w - 1); x++)
+            {
+                for (int j = cell_head[y * grid_w + x]; j != -1; j = next[j])
+                {
+                    if (nms_suppressed(a, areas[i], objects[j], areas[j], nms_threshold))
+                    {
+                        keep = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (keep)
+        {
+            picked.push_back(i);
+
+            if ((int)picked.size() == max_count)
+                break;
+
+            next[i] = cell_head[gy * grid_w + gx];
+            cell_head[gy * grid_w + gx] = i;
+        }
+    }
+}
+
+// weighted nms like mediapipe blazeface, each pick claims every proposal not claimed yet that
+// overlaps it, the detector then blends each cluster by score instead of dropping the members
+//
+// cluster_of[i] is the index into picked of the cluster proposal i joined, -1 if none
+template<typename T>
+static void nms_sorted_clusters(const std::vector<T>& objects, std::vector<int>& picked, std::vector<int>& cluster_of, NmsScratch& scratch, float nms_threshold, int max_count = 0)
+{
+    picked.clear();
+
+    const int n = objects.size();
+    cluster_of.assign(n, -1);
+
+    std::vector<float>& areas = scratch.areas;
+    areas.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        areas[i] = objects[i].rect.area();
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (cluster_of[i] != -1)
+            continue;
+
+        if (max_count > 0 && (int)picked.size() == max_count)
+            break;
+
+        const int k = picked.size();
+        picked.push_back(i);
+        cluster_of[i] = k;
+
+        for (int j = i + 1; j < n; j++)
+        {
+            if (cluster_of[j] == -1 && nms_suppressed(objects[j], areas[j], objects[i], areas[i], nms_threshold))
+                cluster_of[j] = k;
+        }
+    }
+}
+
+#endif // NMS_H
@@ -0,0 +1,247 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef SSDANCHORS_H
+#define SSDANCHORS_H
+
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include <net.h>
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
+// anchor layout of the paddle blazeface ssd head, aspect ratio 1 at strides 8 and 16
+static const int ssd_num_steps = 2;
+static const int ssd_steps[2] = { 8, 16 };
+static const int ssd_num_min_sizes[2] = { 2, 6 };
+static const float ssd_min_sizes[2][6] = {
+    { 16.f, 24.f },
+    { 32.f, 48.f, 64.f, 80.f, 96.f, 128.f }
+};
+
+// prior boxes of the paddle blazeface ssd head, one table per padded input shape
+//
+// rows cx cy w h in normalized image units, each row padded to a multiple of 4 floats
+// so it stays 16 byte aligned, num_anchors is the count of valid columns
+struct SsdAnchorTable
+{
+    ncnn::Mat anchors;
+    int num_anchors;
+};
+
+// tables are built on first use for each shape and kept, a camera only ever produces a couple
+// of shapes, lookups may come from several threads at once
+class SsdAnchors
+{
+public:
+    SsdAnchors() {}
+
+    SsdAnchorTable table(int image_w, int image_h)
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        std::map<std::pair<int, int>, SsdAnchorTable>::iterator it = tables.find(std::make_pair(image_w, image_h));
+        if (it != tables.end())
+            return it->second;
+
+        SsdAnchorTable& table = tables[std::make_pair(image_w, image_h)];
+
+        table.num_anchors = 0;
+        for (int i = 0; i < ssd_num_steps; i++)
+        {
+            int feat_w = image_w / ssd_steps[i];
+            int feat_h = image_h / ssd_steps[i];
+            table.num_anchors += feat_w * feat_h * ssd_num_min_sizes[i];
+        }
+
+        table.anchors.create((table.num_anchors + 3) / 4 * 4, 4);
+        table.anchors.fill(0.f);
+
+        int n = 0;
+        for (int i = 0; i < ssd_num_steps; i++)
+        {
+            n = generate_anchors(table, image_w, image_h, i, n);
+        }
+
+        return table;
+    }
+
+    void clear()
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        tables.clear();
+    }
+
+private:
+    // writes the anchors of step index s from index start on, returns the index past the last one
+    static int generate_anchors(SsdAnchorTable& table, int image_w, int image_h, int s, int start)
+    {
+        const float step = ssd_steps[s];
+        const int feat_w = image_w / ssd_steps[s];
+        const int feat_h = image_h / ssd_steps[s];
+
+        float* anchor_cx = table.anchors.row(0);
+        float* anchor_cy = table.anchors.row(1);
+        float* anchor_w = table.anchors.row(2);
+        float* anchor_h = table.anchors.row(3);
+
+        // aspect ratio 1 only, so each anchor is a min_size square centered on its cell
+        int n = start;
+        for (int i = 0; i < feat_h; i++)
+        {
+            const float center_y = (i + 0.5f) * step;
+
+            for (int j = 0; j < feat_w; j++)
+            {
+                const float center_x = (j + 0.5f) * step;
+
+                for (int k = 0; k < ssd_num_min_sizes[s]; k++)
+                {
+                    anchor_cx[n] = center_x / image_w;
+                    anchor_cy[n] = center_y / image_h;
+                    anchor_w[n] = ssd_min_sizes[s][k] / image_w;
+                    anchor_h[n] = ssd_min_sizes[s][k] / image_h;
+                    n++;
+                }
+            }
+        }
+
+        return n;
+    }
+
+    SsdAnchors(const SsdAnchors&);
+    SsdAnchors& operator=(const SsdAnchors&);
+
+    ncnn::Mutex lock;
+    std::map<std::pair<int, int>, SsdAnchorTable> tables;
+};
+
+// indices of the anchors scoring above the threshold, the only pass over every anchor
+static int ssd_scan_scores(const float* score_data, int num_anchors, float score_threshold, int* indices)
+{
+    int count = 0;
+    int i = 0;
+#if __ARM_NEON
+    float32x4_t _threshold = vdupq_n_f32(score_threshold);
+    for (; i + 3 < num_anchors; i += 4)
+    {
+        float32x4x2_t _score = vld2q_f32(score_data + i * 2);
+        uint32x4_t _mask = vcgtq_f32(_score.val[0], _threshold);
+
+        // nearly every group is rejected, test the whole mask first
+        uint32x2_t _any = vorr_u32(vget_low_u32(_mask), vget_high_u32(_mask));
+        if ((vget_lane_u32(_any, 0) | vget_lane_u32(_any, 1)) == 0)
+            continue;
+
+        // compact without branching, each lane writes its index and advances on a hit
+        indices[count] = i;
+        count += vgetq_lane_u32(_mask, 0) & 1;
+        indices[count] = i + 1;
+        count += vgetq_lane_u32(_mask, 1) & 1;
+        indices[count] = i + 2;
+        count += vgetq_lane_u32(_mask, 2) & 1;
+        indices[count] = i + 3;
+        count += vgetq_lane_u32(_mask, 3) & 1;
+    }
+#endif // __ARM_NEON
+    for (; i < num_anchors; i++)
+    {
+        indices[count] = i;
+        count += score_data[i * 2 + 0] > score_threshold;
+    }
+
+    return count;
+}
+
+// exp as 2^n * p(f) with the cephes exp2f polynomial, relative error below 1e-7
+static inline float ssd_fast_exp(float x)
+{
+    x = std::max(std::min(x, 88.f), -87.f);
+
+    const float t = x * 1.44269504f;
+    const float n = floorf(t + 0.5f);
+    const float f = t - n;
+
+    float p = 1.535336188319500e-4f;
+    p = p * f + 1.339887440266574e-3f;
+    p = p * f + 9.618437357674640e-3f;
+    p = p * f + 5.550332471162809e-2f;
+    p = p * f + 2.402264791363012e-1f;
+    p = p * f + 6.931472028550421e-1f;
+    p = p * f + 1.f;
+
+    union
+    {
+        int i;
+        float f;
+    } e;
+    e.i = ((int)n + 127) << 23;
+
+    return p * e.f;
+}
+
+// score first decoding, only anchors above the threshold are decoded into boxes in padded input pixels
+//
+// T needs cv::Rect_<float> rect and float prob members, indices is scratch grown to the anchor count
+template<typename T>
+static void ssd_decode_proposals(const SsdAnchorTable& table, const ncnn::Mat& score_blob, const ncnn::Mat& bbox_blob, float score_threshold, int image_w, int image_h, std::vector<int>& indices, std::vector<T>& proposals)
+{
+    const float* score_data = score_blob;
+    const float* bbox_data = bbox_blob;
+    const float* anchor_cx = table.anchors.row(0);
+    const float* anchor_cy = table.anchors.row(1);
+    const float* anchor_w = table.anchors.row(2);
+    const float* anchor_h = table.anchors.row(3);
+
+    // never read past the blobs if the net disagrees with the anchor layout
+    const int num_anchors = std::min(table.num_anchors, std::min(score_blob.h, bbox_blob.h));
+
+    if ((int)indices.size() < num_anchors)
+        indices.resize(num_anchors);
+
+    const int count = ssd_scan_scores(score_data, num_anchors, score_threshold, indices.data());
+
+    proposals.resize(count);
+    for (int k = 0; k < count; k++)
+    {
+        const int i = indices[k];
+        const float* bbox = bbox_data + i * 4;
+
+        // variances 0.1 for the center and 0.2 for the size
+        float x_center = anchor_cx[i] + bbox[0] * anchor_w[i] * 0.1f;
+        float y_center = anchor_cy[i] + bbox[1] * anchor_h[i] * 0.1f;
+        float half_w = ssd_fast_exp(bbox[2] * 0.2f) * anchor_w[i] * 0.5f;
+        float half_h = ssd_fast_exp(bbox[3] * 0.2f) * anchor_h[i] * 0.5f;
+
+        float x1 = std::max(std::min(x_center - half_w, 1.f), 0.f) * image_w;
+        float y1 = std::max(std::min(y_center - half_h, 1.f), 0.f) * image_h;
+        float x2 = std::max(std::min(x_center + half_w, 1.f), 0.f) * image_w;
+        float y2 = std::max(std::min(y_center + half_h, 1.f), 0.f) * image_h;
+
+        proposals[k].rect = cv::Rect_<float>(x1, y1, x2 - x1, y2 - y1);
+        proposals[k].prob = std::max(std::min(score_data[i * 2 + 0], 1.f), 0.f);
+    }
+}
+
+#endif // SSDANCHORS_H
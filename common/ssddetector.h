@@ -0,0 +1,61 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef SSDDETECTOR_H
+#define SSDDETECTOR_H
+
+#include "facedetector.h"
+#include "ssdanchors.h"
+
+// paddle blazeface, score and box heads on ssd anchors at strides 8 and 16, no keypoints
+class SsdDetectorBackend : public DetectorBackend
+{
+public:
+    virtual const char* name() const { return "paddle_blazeface"; }
+
+    virtual const char* input_name() const { return "image"; }
+
+    virtual int pad_multiple() const { return 16; }
+
+    // imagenet mean and std
+    virtual const float* mean_values() const
+    {
+        static const float mean_vals[3] = {123.675f, 116.28f, 103.53f};
+        return mean_vals;
+    }
+
+    virtual const float* norm_values() const
+    {
+        static const float norm_vals[3] = {0.017125f, 0.017507f, 0.017429f};
+        return norm_vals;
+    }
+
+    virtual void decode(ncnn::Extractor& ex, const ncnn::Mat& in_pad, float prob_threshold, DetectorScratch& scratch) const
+    {
+        ncnn::Mat scores;
+        ncnn::Mat boxes;
+        ex.extract("scores", scores);
+        ex.extract("boxes", boxes);
+
+        const SsdAnchorTable table = anchors.table(in_pad.w, in_pad.h);
+
+        ssd_decode_proposals(table, scores, boxes, prob_threshold, in_pad.w, in_pad.h, scratch.indices, scratch.proposals);
+    }
+
+private:
+    // tables are built per padded shape on first use, the lookup is locked
+    mutable SsdAnchors anchors;
+};
+
+#endif // SSDDETECTOR_H
@@ -0,0 +1,76 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "stagepolicy.h"
+
+static unsigned long long affinity_bits(const ncnn::CpuSet& affinity)
+{
+    unsigned long long bits = 0;
+
+    const int cpu_count = ncnn::get_cpu_count();
+    for (int i = 0; i < cpu_count && i < 64; i++)
+    {
+        if (affinity.is_enabled(i))
+            bits |= 1ull << i;
+    }
+
+    return bits;
+}
+
+StagePolicy::StagePolicy(int powersave, int num_threads)
+{
+    _powersave = powersave;
+    _num_threads = num_threads;
+
+    set_affinity(ncnn::get_cpu_thread_affinity_mask(powersave));
+}
+
+void StagePolicy::set_affinity(const ncnn::CpuSet& affinity)
+{
+    _affinity = affinity;
+    _affinity_bits = affinity_bits(affinity);
+}
+
+int StagePolicy::num_threads() const
+{
+    if (_num_threads > 0)
+        return _num_threads;
+
+    int enabled = _affinity.num_enabled();
+    return enabled > 0 ? enabled : ncnn::get_big_cpu_count();
+}
+
+void StagePolicy::bind() const
+{
+    // rebinding costs one parallel region, skip it while consecutive stages share a mask and thread count
+    // binding only pins the workers that exist at the time, so a new thread count binds again
+    // ~0ull matches no mask of a real device, so even an all zero mask is applied once
+    static thread_local unsigned long long applied_bits = ~0ull;
+    static thread_local int applied_threads = 0;
+
+    const int threads = num_threads();
+    if (applied_bits != _affinity_bits || applied_threads != threads)
+    {
+        ncnn::set_cpu_thread_affinity(_affinity);
+        applied_bits = _affinity_bits;
+        applied_threads = threads;
+    }
+}
+
+void StagePolicy::apply(ncnn::Extractor& ex) const
+{
+    bind();
+
+    ex.set_num_threads(num_threads());
+}
@@ -0,0 +1,51 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef STAGEPOLICY_H
+#define STAGEPOLICY_H
+
+#include <cpu.h>
+#include <net.h>
+
+// thread count, cpu affinity and powersave mode of one pipeline stage
+//
+// applied per extractor instead of through the process wide ncnn settings,
+// so the detector and the landmark stage no longer overwrite each other
+class StagePolicy
+{
+public:
+    // powersave 0 = all cores, 1 = little cores, 2 = big cores
+    // num_threads 0 = one thread per core in the affinity mask
+    explicit StagePolicy(int powersave = 2, int num_threads = 0);
+
+    void set_affinity(const ncnn::CpuSet& affinity);
+
+    int powersave() const { return _powersave; }
+    int num_threads() const;
+
+    // bind the openmp team of the calling thread to this stage's cores
+    // call before opening a parallel region whose workers run single threaded extractors
+    void bind() const;
+
+    // bind, then size the extractor
+    void apply(ncnn::Extractor& ex) const;
+
+private:
+    int _powersave;
+    int _num_threads;
+    ncnn::CpuSet _affinity;
+    unsigned long long _affinity_bits;
+};
+
+#endif // STAGEPOLICY_H
@@ -0,0 +1,164 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// runs several threads against one Face and checks every result against the single threaded one
+//
+// usage: face_stress <model dir> <image dir> [threads] [iterations per thread]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "face.h"
+
+static bool points_match(const std::vector<cv::Point2f>& a, const std::vector<cv::Point2f>& b, float eps)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (fabs(a[i].x - b[i].x) > eps || fabs(a[i].y - b[i].y) > eps)
+            return false;
+    }
+
+    return true;
+}
+
+static bool objects_match(const std::vector<Object>& a, const std::vector<Object>& b)
+{
+    const float eps = 1e-3f;
+
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (fabs(a[i].rect.x - b[i].rect.x) > eps || fabs(a[i].rect.y - b[i].rect.y) > eps
+                || fabs(a[i].rect.width - b[i].rect.width) > eps || fabs(a[i].rect.height - b[i].rect.height) > eps
+                || fabs(a[i].score - b[i].score) > eps)
+            return false;
+
+        if (!points_match(a[i].skeleton, b[i].skeleton, eps)
+                || !points_match(a[i].left_eyes, b[i].left_eyes, eps)
+                || !points_match(a[i].right_eyes, b[i].right_eyes, eps))
+            return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <model dir> <image dir> [threads] [iterations]\n", argv[0]);
+        return -1;
+    }
+
+    const int num_threads = argc > 3 ? atoi(argv[3]) : 4;
+    const int iterations = argc > 4 ? atoi(argv[4]) : 20;
+
+    std::vector<cv::String> paths;
+    cv::glob(std::string(argv[2]) + "/*.jpg", paths);
+
+    std::vector<cv::Mat> images;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        cv::Mat bgr = cv::imread(paths[i], 1);
+        if (bgr.empty())
+            continue;
+
+        cv::Mat rgb;
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+        images.push_back(rgb);
+        names.push_back(paths[i]);
+    }
+
+    if (images.empty())
+    {
+        fprintf(stderr, "no jpg images in %s\n", argv[2]);
+        return -1;
+    }
+
+    // host model loading reads .param and .bin from the working directory
+    if (chdir(argv[1]) != 0)
+    {
+        fprintf(stderr, "cannot enter %s\n", argv[1]);
+        return -1;
+    }
+
+    Face face;
+    if (face.load(0, "blazeface", 192) != 0)
+    {
+        fprintf(stderr, "cannot load the models from %s\n", argv[1]);
+        return -1;
+    }
+
+    // reference results, one call at a time
+    std::vector<std::vector<Object> > reference(images.size());
+    int reference_faces = 0;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        face.detect(images[i], reference[i]);
+        reference_faces += reference[i].size();
+    }
+
+    fprintf(stderr, "%d images, %d faces in the single threaded pass\n", (int)images.size(), reference_faces);
+
+    std::atomic<int> mismatches(0);
+    std::atomic<int> calls(0);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; t++)
+    {
+        workers.push_back(std::thread([&, t]() {
+            std::vector<Object> objects;
+            for (int k = 0; k < iterations; k++)
+            {
+                // threads start on different images so every pair of images overlaps at some point
+                const size_t i = (t + k) % images.size();
+
+                face.detect(images[i], objects);
+                calls++;
+
+                if (!objects_match(objects, reference[i]))
+                {
+                    fprintf(stderr, "thread %d iteration %d image %s differs from the single threaded result\n", t, k, names[i].c_str());
+                    mismatches++;
+                }
+            }
+        }));
+    }
+
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    fprintf(stderr, "%d concurrent calls on %d threads, %d mismatches\n", calls.load(), num_threads, mismatches.load());
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// luma detector input against the full nv21 one, faces found by the full input are the reference
+//
+// usage: luma_bench <model dir> <image dir> [target size] [runs]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "benchmark.h"
+
+#include "face.h"
+
+// even sized nv21 copy of an rgb image, the camera frame the app would see
+static std::vector<unsigned char> rgb_to_nv21(const cv::Mat& rgb, int* width, int* height)
+{
+    const int w = rgb.cols / 2 * 2;
+    const int h = rgb.rows / 2 * 2;
+
+    cv::Mat i420;
+    cv::cvtColor(rgb(cv::Rect(0, 0, w, h)), i420, cv::COLOR_RGB2YUV_I420);
+
+    std::vector<unsigned char> nv21(w * h * 3 / 2);
+    memcpy(nv21.data(), i420.data, w * h);
+
+    const unsigned char* u = i420.data + w * h;
+    const unsigned char* v = u + w * h / 4;
+    unsigned char* vu = nv21.data() + w * h;
+    for (int i = 0; i < w * h / 4; i++)
+    {
+        vu[i * 2] = v[i];
+        vu[i * 2 + 1] = u[i];
+    }
+
+    *width = w;
+    *height = h;
+    return nv21;
+}
+
+static float iou(const cv::Rect_<float>& a, const cv::Rect_<float>& b)
+{
+    const float inter = (a & b).area();
+    const float uni = a.area() + b.area() - inter;
+    return uni > 0.f ? inter / uni : 0.f;
+}
+
+struct Frame
+{
+    std::vector<unsigned char> nv21;
+    int width;
+    int height;
+};
+
+static double time_detect(const Face& face, const std::vector<Frame>& frames, int runs)
+{
+    std::vector<Object> objects;
+
+    double t0 = ncnn::get_current_time();
+    for (int k = 0; k < runs; k++)
+    {
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            SensorFrame frame = { frames[i].nv21.data(), frames[i].width, frames[i].height, cv::Rect(0, 0, frames[i].width, frames[i].height), 1 };
+            face.detect(frame, objects);
+        }
+    }
+    double t1 = ncnn::get_current_time();
+
+    return (t1 - t0) / (runs * frames.size());
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <model dir> <image dir> [target size] [runs]\n", argv[0]);
+        return -1;
+    }
+
+    const int target_size = argc > 3 ? atoi(argv[3]) : 192;
+    const int runs = argc > 4 ? atoi(argv[4]) : 10;
+
+    std::vector<cv::String> paths;
+    cv::glob(std::string(argv[2]) + "/*.jpg", paths);
+
+    std::vector<Frame> frames;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        cv::Mat bgr = cv::imread(paths[i], 1);
+        if (bgr.empty())
+            continue;
+
+        cv::Mat rgb;
+        cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+
+        Frame frame;
+        frame.nv21 = rgb_to_nv21(rgb, &frame.width, &frame.height);
+        frames.push_back(frame);
+    }
+
+    if (frames.empty())
+    {
+        fprintf(stderr, "no jpg images in %s\n", argv[2]);
+        return -1;
+    }
+
+    if (chdir(argv[1]) != 0)
+    {
+        fprintf(stderr, "cannot enter %s\n", argv[1]);
+        return -1;
+    }
+
+    Face face;
+    if (face.load(0, "blazeface", target_size) != 0)
+    {
+        fprintf(stderr, "cannot load the models from %s\n", argv[1]);
+        return -1;
+    }
+
+    int reference_faces = 0;
+    int luma_faces = 0;
+    int matched = 0;
+    float matched_iou = 0.f;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        SensorFrame frame = { frames[i].nv21.data(), frames[i].width, frames[i].height, cv::Rect(0, 0, frames[i].width, frames[i].height), 1 };
+
+        std::vector<Object> reference;
+        face.set_luma_detector(false);
+        face.detect(frame, reference);
+
+        std::vector<Object> objects;
+        face.set_luma_detector(true);
+        face.detect(frame, objects);
+
+        reference_faces += reference.size();
+        luma_faces += objects.size();
+
+        // greedy best iou match, each luma face pairs with at most one reference face
+        std::vector<bool> used(objects.size(), false);
+        for (size_t j = 0; j < reference.size(); j++)
+        {
+            int best = -1;
+            float best_iou = 0.5f;
+            for (size_t k = 0; k < objects.size(); k++)
+            {
+                const float o = iou(reference[j].rect, objects[k].rect);
+                if (!used[k] && o >= best_iou)
+                {
+                    best = k;
+                    best_iou = o;
+                }
+            }
+
+            if (best >= 0)
+            {
+                used[best] = true;
+                matched++;
+                matched_iou += best_iou;
+            }
+        }
+    }
+
+    fprintf(stderr, "%d images at %d, %d reference faces\n", (int)frames.size(), target_size, reference_faces);
+    fprintf(stderr, "luma recall %.3f  extra faces %d  mean iou %.3f\n",
+            reference_faces ? (float)matched / reference_faces : 1.f, luma_faces - matched, matched ? matched_iou / matched : 0.f);
+
+    face.set_luma_detector(false);
+    const double nv21_ms = time_detect(face, frames, runs);
+    face.set_luma_detector(true);
+    const double luma_ms = time_detect(face, frames, runs);
+
+    fprintf(stderr, "input  ms per frame\n");
+    fprintf(stderr, "nv21   %12.2f\n", nv21_ms);
+    fprintf(stderr, "luma   %12.2f\n", luma_ms);
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// proposal ordering and nms stability
+//
+// sort: the recursive quicksort with omp sections the detectors used before against
+// sort_proposals_descent, on random scores of the proposal counts a frame produces
+//
+// stability: hard against weighted nms on a still face seen through jittered proposals,
+// the box a detection hands the landmark stage moves from frame to frame even though the
+// face does not, a frame whose box overlaps the previous one by less than the lock iou is
+// counted as a frame where the tracker would lose the face and detect again
+//
+// usage: nms_bench [frames] [sort runs]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "nmsproposals.h"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// the ordering both detectors used before sort_proposals_descent, a team per recursion level
+static void qsort_descent_inplace(std::vector<Proposal>& objects, int left, int right)
+{
+    int i = left;
+    int j = right;
+    float p = objects[(left + right) / 2].prob;
+
+    while (i <= j)
+    {
+        while (objects[i].prob > p)
+            i++;
+
+        while (objects[j].prob < p)
+            j--;
+
+        if (i <= j)
+        {
+            // swap
+            std::swap(objects[i], objects[j]);
+
+            i++;
+            j--;
+        }
+    }
+
+#pragma omp parallel sections
+    {
+#pragma omp section
+        {
+            if (left < j) qsort_descent_inplace(objects, left, j);
+        }
+#pragma omp section
+        {
+            if (i < right) qsort_descent_inplace(objects, i, right);
+        }
+    }
+}
+
+static void qsort_descent_inplace(std::vector<Proposal>& objects)
+{
+    if (objects.empty())
+        return;
+
+    qsort_descent_inplace(objects, 0, objects.size() - 1);
+}
+
+// microseconds per ordering of n proposals, both sorts start from the same shuffled copies
+static void time_sort(int n, int runs, double* qsort_us, double* partial_us, int max_count)
+{
+    std::mt19937 rng(n);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    std::vector<Proposal> input(n);
+    for (int i = 0; i < n; i++)
+    {
+        input[i].rect.x = 0.f;
+        input[i].rect.y = 0.f;
+        input[i].rect.width = 1.f;
+        input[i].rect.height = 1.f;
+        input[i].prob = unit(rng);
+    }
+
+    std::vector<Proposal> objects;
+
+    double t0 = get_current_time();
+    for (int k = 0; k < runs; k++)
+    {
+        objects = input;
+        qsort_descent_inplace(objects);
+    }
+    double t1 = get_current_time();
+    for (int k = 0; k < runs; k++)
+    {
+        objects = input;
+        sort_proposals_descent(objects, max_count, proposal_greater);
+    }
+    double t2 = get_current_time();
+
+    // the copy is in both loops, time it alone and take it out
+    for (int k = 0; k < runs; k++)
+    {
+        objects = input;
+        asm volatile("" : : "r"(objects.data()) : "memory");
+    }
+    double t3 = get_current_time();
+
+    *qsort_us = (t1 - t0 - (t3 - t2)) * 1000.0 / runs;
+    *partial_us = (t2 - t1 - (t3 - t2)) * 1000.0 / runs;
+}
+
+// score weighted mean of every cluster member, the box part of blend_proposal_clusters
+static Box blend_first_cluster(const std::vector<Proposal>& proposals, const std::vector<int>& cluster_of)
+{
+    Box box = {0.f, 0.f, 0.f, 0.f};
+    float weight = 0.f;
+    for (size_t i = 0; i < proposals.size(); i++)
+    {
+        if (cluster_of[i] != 0)
+            continue;
+
+        const float w = proposals[i].prob;
+        box.x += proposals[i].rect.x * w;
+        box.y += proposals[i].rect.y * w;
+        box.width += proposals[i].rect.width * w;
+        box.height += proposals[i].rect.height * w;
+        weight += w;
+    }
+
+    box.x /= weight;
+    box.y /= weight;
+    box.width /= weight;
+    box.height /= weight;
+    return box;
+}
+
+struct Stability
+{
+    double center_jitter;
+    double truth_iou;
+    int lost[2];
+};
+
+static const float lock_ious[2] = {0.85f, 0.9f};
+
+static Stability measure(bool weighted, const Box& face, float sigma, int frames)
+{
+    // same seed for both modes, they see identical proposals
+    std::mt19937 rng(20211021);
+
+    std::vector<Proposal> proposals;
+    NmsScratch scratch;
+    std::vector<int> picked;
+    std::vector<int> cluster_of;
+
+    Stability s = {0.0, 0.0, {0, 0}};
+    Box previous = face;
+    for (int f = 0; f < frames; f++)
+    {
+        jittered_proposals(rng, face, sigma, proposals);
+
+        Box box;
+        if (weighted)
+        {
+            nms_sorted_clusters(proposals, picked, cluster_of, scratch, 0.3f, 1);
+            box = blend_first_cluster(proposals, cluster_of);
+        }
+        else
+        {
+            nms_sorted_bboxes(proposals, picked, scratch, 0.3f, 1);
+            box = proposals[picked[0]].rect;
+        }
+
+        const float dx = (box.x + box.width * 0.5f) - (previous.x + previous.width * 0.5f);
+        const float dy = (box.y + box.height * 0.5f) - (previous.y + previous.height * 0.5f);
+        s.center_jitter += sqrtf(dx * dx + dy * dy);
+        s.truth_iou += iou(box, face);
+
+        const float frame_iou = iou(box, previous);
+        for (int k = 0; k < 2; k++)
+        {
+            if (frame_iou < lock_ious[k])
+                s.lost[k]++;
+        }
+
+        previous = box;
+    }
+
+    s.center_jitter /= frames;
+    s.truth_iou /= frames;
+    return s;
+}
+
+int main(int argc, char** argv)
+{
+    const int frames = argc > 1 ? atoi(argv[1]) : 10000;
+    const int sort_runs = argc > 2 ? atoi(argv[2]) : 2000;
+
+    // a handful after thresholding, a few hundred at low thresholds, the 512 cap of the detectors
+    const int counts[] = {8, 32, 128, 512, 2048};
+
+    fprintf(stderr, "%d runs per point, sort_proposals_descent keeps the best 512\n", sort_runs);
+    fprintf(stderr, "proposals  qsort+omp us  partial us\n");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        double qsort_us = 0.0;
+        double partial_us = 0.0;
+        time_sort(counts[i], sort_runs, &qsort_us, &partial_us, 512);
+        fprintf(stderr, "%9d  %12.2f  %10.2f\n", counts[i], qsort_us, partial_us);
+    }
+
+    // a 128 pixel face in a 640 frame, regression error as a fraction of the face size
+    const Box face = {256.f, 176.f, 128.f, 128.f};
+    const float sigmas[] = {0.02f, 0.04f, 0.08f};
+
+    fprintf(stderr, "%d frames per point, redetect counts frames with iou to the previous box below %.2f / %.2f\n", frames, lock_ious[0], lock_ious[1]);
+    fprintf(stderr, "sigma  nms       jitter px  truth iou  redetect %.2f  redetect %.2f\n", lock_ious[0], lock_ious[1]);
+    for (size_t i = 0; i < sizeof(sigmas) / sizeof(sigmas[0]); i++)
+    {
+        for (int weighted = 0; weighted < 2; weighted++)
+        {
+            Stability s = measure(weighted, face, sigmas[i] * face.width, frames);
+            fprintf(stderr, "%.2f   %-8s  %9.2f  %9.3f  %12.2f%%  %12.2f%%\n", sigmas[i], weighted ? "weighted" : "hard",
+                    s.center_jitter, s.truth_iou, 100.0 * s.lost[0] / frames, 100.0 * s.lost[1] / frames);
+        }
+    }
+
+    return 0;
+}
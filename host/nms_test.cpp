@@ -0,0 +1,140 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// hard and weighted nms from common/nms.h against a brute force reference on random proposals
+//
+// usage: nms_test [rounds]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+#include "nmsproposals.h"
+
+// textbook hard nms, every proposal against every box picked so far
+static void brute_force_nms(const std::vector<Proposal>& objects, std::vector<int>& picked, float nms_threshold, int max_count)
+{
+    picked.clear();
+
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        bool keep = true;
+        for (size_t j = 0; j < picked.size(); j++)
+        {
+            if (iou(objects[i].rect, objects[picked[j]].rect) > nms_threshold)
+                keep = false;
+        }
+
+        if (keep)
+            picked.push_back(i);
+
+        if (max_count > 0 && (int)picked.size() == max_count)
+            break;
+    }
+}
+
+static int check_hard(const std::vector<Proposal>& objects, float nms_threshold, int max_count)
+{
+    NmsScratch scratch;
+    std::vector<int> picked;
+    std::vector<int> expected;
+    nms_sorted_bboxes(objects, picked, scratch, nms_threshold, max_count);
+    brute_force_nms(objects, expected, nms_threshold, max_count);
+
+    if (picked != expected)
+    {
+        fprintf(stderr, "hard nms n=%d t=%.2f max_count=%d picked %d boxes, brute force %d\n", (int)objects.size(), nms_threshold, max_count, (int)picked.size(), (int)expected.size());
+        return 1;
+    }
+
+    return 0;
+}
+
+// the cluster heads are the hard nms picks, each member overlaps its own head and no earlier head
+static int check_clusters(const std::vector<Proposal>& objects, float nms_threshold, int max_count)
+{
+    NmsScratch scratch;
+    std::vector<int> picked;
+    std::vector<int> cluster_of;
+    nms_sorted_clusters(objects, picked, cluster_of, scratch, nms_threshold, max_count);
+
+    std::vector<int> expected;
+    brute_force_nms(objects, expected, nms_threshold, max_count);
+
+    if (picked != expected)
+    {
+        fprintf(stderr, "weighted nms n=%d t=%.2f max_count=%d picked %d heads, brute force %d\n", (int)objects.size(), nms_threshold, max_count, (int)picked.size(), (int)expected.size());
+        return 1;
+    }
+
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        int first = -1;
+        for (int k = 0; k < (int)picked.size() && picked[k] <= i; k++)
+        {
+            if (picked[k] == i || iou(objects[i].rect, objects[picked[k]].rect) > nms_threshold)
+            {
+                first = k;
+                break;
+            }
+        }
+
+        if (cluster_of[i] != first)
+        {
+            fprintf(stderr, "weighted nms n=%d t=%.2f max_count=%d proposal %d in cluster %d, expected %d\n", (int)objects.size(), nms_threshold, max_count, i, cluster_of[i], first);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const int rounds = argc > 1 ? atoi(argv[1]) : 200;
+
+    std::mt19937 rng(20211021);
+
+    // sizes on both sides of nms_bucket_min_proposals so the scan and the grid are both covered
+    const int sizes[] = {0, 1, 5, 31, 32, 100, 500};
+    const float thresholds[] = {0.f, 0.3f, 0.5f, 0.9f};
+    const int max_counts[] = {0, 1, 3};
+
+    int failures = 0;
+    int cases = 0;
+    std::vector<Proposal> objects;
+    for (int r = 0; r < rounds; r++)
+    {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            random_proposals(rng, sizes[s], objects);
+
+            for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++)
+            {
+                for (size_t m = 0; m < sizeof(max_counts) / sizeof(max_counts[0]); m++)
+                {
+                    failures += check_hard(objects, thresholds[t], max_counts[m]);
+                    failures += check_clusters(objects, thresholds[t], max_counts[m]);
+                    cases += 2;
+                }
+            }
+        }
+    }
+
+    fprintf(stderr, "%d cases, %d failures\n", cases, failures);
+
+    return failures == 0 ? 0 : 1;
+}
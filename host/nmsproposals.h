@@ -0,0 +1,126 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NMSPROPOSALS_H
+#define NMSPROPOSALS_H
+
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "nms.h"
+
+// the members of cv::Rect_<float> nms.h touches, keeps the host tools free of opencv
+struct Box
+{
+    float x;
+    float y;
+    float width;
+    float height;
+
+    float area() const { return width * height; }
+};
+
+struct Proposal
+{
+    Box rect;
+    float prob;
+};
+
+static inline bool proposal_greater(const Proposal& a, const Proposal& b)
+{
+    return a.prob > b.prob;
+}
+
+static inline float iou(const Box& a, const Box& b)
+{
+    const float inter_w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+    const float inter_h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+    if (inter_w <= 0.f || inter_h <= 0.f)
+        return 0.f;
+
+    const float inter_area = inter_w * inter_h;
+    return inter_area / (a.area() + b.area() - inter_area);
+}
+
+// faces clumped around a few centers so clusters form, plus scattered boxes for the grid edges
+static inline void random_proposals(std::mt19937& rng, int n, std::vector<Proposal>& objects)
+{
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::normal_distribution<float> jitter(0.f, 6.f);
+
+    const int num_faces = 1 + rng() % 4;
+    std::vector<Box> faces(num_faces);
+    for (int k = 0; k < num_faces; k++)
+    {
+        const float size = 24.f + unit(rng) * 120.f;
+        faces[k].x = unit(rng) * 480.f;
+        faces[k].y = unit(rng) * 480.f;
+        faces[k].width = size;
+        faces[k].height = size;
+    }
+
+    objects.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        Proposal& p = objects[i];
+        if (unit(rng) < 0.8f)
+        {
+            const Box& f = faces[rng() % num_faces];
+            p.rect.x = f.x + jitter(rng);
+            p.rect.y = f.y + jitter(rng);
+            p.rect.width = std::max(f.width + jitter(rng), 4.f);
+            p.rect.height = std::max(f.height + jitter(rng), 4.f);
+        }
+        else
+        {
+            p.rect.x = unit(rng) * 600.f;
+            p.rect.y = unit(rng) * 600.f;
+            p.rect.width = 4.f + unit(rng) * 160.f;
+            p.rect.height = 4.f + unit(rng) * 160.f;
+        }
+
+        p.prob = unit(rng);
+    }
+
+    sort_proposals_descent(objects, 0, proposal_greater);
+}
+
+// anchors of neighbouring cells all fire on the face, each with its own regression error
+static inline void jittered_proposals(std::mt19937& rng, const Box& face, float sigma, std::vector<Proposal>& proposals)
+{
+    std::normal_distribution<float> jitter(0.f, sigma);
+    std::normal_distribution<float> score_noise(0.f, 0.03f);
+
+    proposals.clear();
+    for (int y = -2; y <= 2; y++)
+    {
+        for (int x = -2; x <= 2; x++)
+        {
+            Proposal p;
+            p.rect.x = face.x + jitter(rng);
+            p.rect.y = face.y + jitter(rng);
+            p.rect.width = face.width + jitter(rng);
+            p.rect.height = face.height + jitter(rng);
+            p.prob = 0.95f - 0.05f * sqrtf((float)(x * x + y * y)) + score_noise(rng);
+            proposals.push_back(p);
+        }
+    }
+
+    sort_proposals_descent(proposals, 0, proposal_greater);
+}
+
+#endif // NMSPROPOSALS_H
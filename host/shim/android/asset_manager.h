@@ -0,0 +1,44 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef HOST_ANDROID_ASSET_MANAGER_H
+#define HOST_ANDROID_ASSET_MANAGER_H
+
+#include <sys/types.h>
+
+// host stand-in for the ndk asset manager, there is no apk so every asset lookup fails
+// and the model loaders read plain files from the working directory instead
+typedef struct AAssetManager AAssetManager;
+typedef struct AAsset AAsset;
+
+enum
+{
+    AASSET_MODE_UNKNOWN = 0
+};
+
+static inline AAsset* AAssetManager_open(AAssetManager* /*mgr*/, const char* /*filename*/, int /*mode*/)
+{
+    return 0;
+}
+
+static inline int AAsset_openFileDescriptor(AAsset* /*asset*/, off_t* /*start*/, off_t* /*length*/)
+{
+    return -1;
+}
+
+static inline void AAsset_close(AAsset* /*asset*/)
+{
+}
+
+#endif // HOST_ANDROID_ASSET_MANAGER_H
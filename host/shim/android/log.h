@@ -0,0 +1,41 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef HOST_ANDROID_LOG_H
+#define HOST_ANDROID_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// host stand-in for the ndk logger, messages go to stderr
+enum
+{
+    ANDROID_LOG_DEBUG = 3,
+    ANDROID_LOG_INFO = 4,
+    ANDROID_LOG_WARN = 5,
+    ANDROID_LOG_ERROR = 6
+};
+
+static inline int __android_log_print(int /*prio*/, const char* tag, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s: ", tag);
+    int ret = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return ret;
+}
+
+#endif // HOST_ANDROID_LOG_H
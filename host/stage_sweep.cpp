@@ -0,0 +1,106 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// per stage thread count sweep, one stage is swept while the other stays single threaded
+//
+// usage: stage_sweep <model dir> <image> [max threads] [runs]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "benchmark.h"
+#include "cpu.h"
+
+#include "face.h"
+
+static double time_detect(const Face& face, const cv::Mat& rgb, int runs)
+{
+    std::vector<Object> objects;
+
+    // first call sizes the pools
+    face.detect(rgb, objects);
+
+    double t0 = ncnn::get_current_time();
+    for (int i = 0; i < runs; i++)
+    {
+        face.detect(rgb, objects);
+    }
+    double t1 = ncnn::get_current_time();
+
+    return (t1 - t0) / runs;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <model dir> <image> [max threads] [runs]\n", argv[0]);
+        return -1;
+    }
+
+    const int max_threads = argc > 3 ? atoi(argv[3]) : ncnn::get_cpu_count();
+    const int runs = argc > 4 ? atoi(argv[4]) : 50;
+
+    cv::Mat bgr = cv::imread(argv[2], 1);
+    if (bgr.empty())
+    {
+        fprintf(stderr, "cannot read %s\n", argv[2]);
+        return -1;
+    }
+
+    cv::Mat rgb;
+    cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+
+    if (chdir(argv[1]) != 0)
+    {
+        fprintf(stderr, "cannot enter %s\n", argv[1]);
+        return -1;
+    }
+
+    Face face;
+    if (face.load(0, "blazeface", 192) != 0)
+    {
+        fprintf(stderr, "cannot load the models from %s\n", argv[1]);
+        return -1;
+    }
+
+    std::vector<Object> objects;
+    face.detect(rgb, objects);
+    fprintf(stderr, "%d faces, %d runs per point\n", (int)objects.size(), runs);
+
+    // powersave 0, every core is a candidate and only the thread count varies
+    fprintf(stderr, "stage     threads  detect ms\n");
+    for (int t = 1; t <= max_threads; t++)
+    {
+        face.set_detector_policy(StagePolicy(0, t));
+        face.set_landmark_policy(StagePolicy(0, 1));
+        fprintf(stderr, "detector  %7d  %9.2f\n", t, time_detect(face, rgb, runs));
+    }
+
+    for (int t = 1; t <= max_threads; t++)
+    {
+        face.set_detector_policy(StagePolicy(0, 1));
+        face.set_landmark_policy(StagePolicy(0, t));
+        fprintf(stderr, "landmark  %7d  %9.2f\n", t, time_detect(face, rgb, runs));
+    }
+
+    return 0;
+}
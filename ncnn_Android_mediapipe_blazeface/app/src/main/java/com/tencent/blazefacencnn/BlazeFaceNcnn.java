@@ -19,7 +19,7 @@ import android.view.Surface;
 
 public class BlazeFaceNcnn
 {
-    public native boolean loadModel(AssetManager mgr, int modelid, int cpugpu);
+    public native boolean loadModel(AssetManager mgr, int modelid, int cpugpu, int power);
     public native boolean openCamera(int facing);
     public native boolean closeCamera();
     public native boolean setOutputWindow(Surface surface);
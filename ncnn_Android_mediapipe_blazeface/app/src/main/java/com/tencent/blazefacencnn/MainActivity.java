@@ -41,8 +41,10 @@ public class MainActivity extends Activity implements SurfaceHolder.Callback
 
     private Spinner spinnerModel;
     private Spinner spinnerCPUGPU;
+    private Spinner spinnerPower;
     private int current_model = 0;
     private int current_cpugpu = 0;
+    private int current_power = 0;
 
     private SurfaceView cameraView;
 
@@ -111,12 +113,30 @@ public class MainActivity extends Activity implements SurfaceHolder.Callback
             }
         });
 
+        spinnerPower = (Spinner) findViewById(R.id.spinnerPower);
+        spinnerPower.setOnItemSelectedListener(new AdapterView.OnItemSelectedListener() {
+            @Override
+            public void onItemSelected(AdapterView<?> arg0, View arg1, int position, long id)
+            {
+                if (position != current_power)
+                {
+                    current_power = position;
+                    reload();
+                }
+            }
+
+            @Override
+            public void onNothingSelected(AdapterView<?> arg0)
+            {
+            }
+        });
+
         reload();
     }
 
     private void reload()
     {
-        boolean ret_init = blazefacencnn.loadModel(getAssets(), current_model, current_cpugpu);
+        boolean ret_init = blazefacencnn.loadModel(getAssets(), current_model, current_cpugpu, current_power);
         if (!ret_init)
         {
             Log.e("MainActivity", "blazefacencnn loadModel failed");
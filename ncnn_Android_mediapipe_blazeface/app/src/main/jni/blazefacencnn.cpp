@@ -20,13 +20,17 @@
 
 #include <jni.h>
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <platform.h>
 #include <benchmark.h>
 
 #include "face.h"
+#include "facetracker.h"
 
 #include "ndkcamera.h"
 
@@ -110,32 +114,65 @@ static int draw_fps(cv::Mat& rgb)
     return 0;
 }
 
-static Face* g_blazeface = 0;
+// the active model is swapped atomically, frames in flight keep the instance they loaded
+static std::shared_ptr<Face> g_blazeface;
 static ncnn::Mutex lock;
+static int g_load_generation = 0;
+
+// loader threads stay joinable so unload can wait for them, finished ones are reaped on the next load
+struct ModelLoader
+{
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool> > done;
+};
+static std::vector<ModelLoader> g_loaders;
+static JavaVM* g_vm = 0;
 
 class MyNdkCamera : public NdkCameraWindow
 {
 public:
+    virtual void on_image_detect(const unsigned char* nv21, int nv21_width, int nv21_height, const cv::Rect& roi, int rotate_type) const;
     virtual void on_image_render(cv::Mat& rgb) const;
+
+private:
+    // detected on the sensor frame, drawn on the upright frame of the same image
+    mutable std::shared_ptr<Face> detect_model;
+    mutable std::vector<Object> faceobjects;
+    mutable FaceTracker tracker;
 };
 
+void MyNdkCamera::on_image_detect(const unsigned char* nv21, int nv21_width, int nv21_height, const cv::Rect& roi, int rotate_type) const
+{
+    std::shared_ptr<Face> blazeface = std::atomic_load(&g_blazeface);
+    if (blazeface != detect_model)
+    {
+        // tracks belong to the model that produced them
+        tracker.reset();
+    }
+
+    detect_model = blazeface;
+
+    faceobjects.clear();
+    if (detect_model)
+    {
+        SensorFrame frame = { nv21, nv21_width, nv21_height, roi, rotate_type };
+        tracker.update(*detect_model, frame, faceobjects);
+    }
+}
+
 void MyNdkCamera::on_image_render(cv::Mat& rgb) const
 {
     // scrfd
     {
-        ncnn::MutexLockGuard g(lock);
-
-        if (g_blazeface)
+        if (detect_model)
         {
-            std::vector<Object> faceobjects;
-            g_blazeface->detect(rgb, faceobjects);
-
-            g_blazeface->draw(rgb, faceobjects);
+            detect_model->draw(rgb, faceobjects);
         }
         else
         {
             draw_unsupported(rgb);
         }
+
     }
 
     draw_fps(rgb);
@@ -143,13 +180,39 @@ void MyNdkCamera::on_image_render(cv::Mat& rgb) const
 
 static MyNdkCamera* g_camera = 0;
 
+// detector input of the last loadModel, picks the capture size on the next openCamera
+static int g_target_size = 192;
+
+// smallest 4:3 stream leaving some headroom over the detector input, the camera picks the nearest it supports
+static void capture_size_for_target(int target_size, int* width, int* height)
+{
+    if (target_size * 3 / 2 <= 240)
+    {
+        *width = 320;
+        *height = 240;
+    }
+    else if (target_size * 3 / 2 <= 480)
+    {
+        *width = 640;
+        *height = 480;
+    }
+    else
+    {
+        *width = 1280;
+        *height = 960;
+    }
+}
+
 extern "C" {
 
 JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved)
 {
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "JNI_OnLoad");
 
+    g_vm = vm;
+
     g_camera = new MyNdkCamera;
+    g_camera->set_sensor_frame_inference(true);
 
     return JNI_VERSION_1_4;
 }
@@ -158,21 +221,34 @@ JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved)
 {
     __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "JNI_OnUnload");
 
+    std::vector<ModelLoader> loaders;
     {
         ncnn::MutexLockGuard g(lock);
 
-        delete g_blazeface;
-        g_blazeface = 0;
+        // drop any load still running in the background
+        g_load_generation++;
+        std::atomic_store(&g_blazeface, std::shared_ptr<Face>());
+
+        loaders.swap(g_loaders);
     }
 
+    // loaders take the lock to publish, so wait for them outside it
+    for (size_t i = 0; i < loaders.size(); i++)
+    {
+        loaders[i].thread.join();
+    }
+
+    // stop frame delivery while the MyNdkCamera members are still alive
+    g_camera->close();
+
     delete g_camera;
     g_camera = 0;
 }
 
-// public native boolean loadModel(AssetManager mgr, int modelid, int cpugpu);
-JNIEXPORT jboolean JNICALL Java_com_tencent_blazefacencnn_BlazeFaceNcnn_loadModel(JNIEnv* env, jobject thiz, jobject assetManager, jint modelid, jint cpugpu)
+// public native boolean loadModel(AssetManager mgr, int modelid, int cpugpu, int power);
+JNIEXPORT jboolean JNICALL Java_com_tencent_blazefacencnn_BlazeFaceNcnn_loadModel(JNIEnv* env, jobject thiz, jobject assetManager, jint modelid, jint cpugpu, jint power)
 {
-    if (modelid < 0 || modelid > 6 || cpugpu < 0 || cpugpu > 1)
+    if (modelid < 0 || modelid > 4 || cpugpu < 0 || cpugpu > 1 || power < 0 || power > 1)
     {
         return JNI_FALSE;
     }
@@ -184,33 +260,94 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_blazefacencnn_BlazeFaceNcnn_loadMode
     {
         "blazeface",
         "blazeface",
-        "blazeface"
+        "blazeface",
+        "paddle_blazeface",
+        "paddle_blazeface"
     };
     const int target_sizes[] =
     {
         192,
         320,
-        640
+        640,
+        128,
+        320
     };
     const char* modeltype = modeltypes[(int)modelid];
     int target_size = target_sizes[(int)modelid];
     bool use_gpu = (int)cpugpu == 1;
+    bool low_power = (int)power == 1;
+
+    g_target_size = target_size;
 
     // reload
     {
         ncnn::MutexLockGuard g(lock);
 
+        const int generation = ++g_load_generation;
+
         if (use_gpu && ncnn::get_gpu_count() == 0)
         {
             // no gpu
-            delete g_blazeface;
-            g_blazeface = 0;
+            std::atomic_store(&g_blazeface, std::shared_ptr<Face>());
         }
         else
         {
-            if (!g_blazeface)
-                g_blazeface = new Face;
-            g_blazeface->load(mgr, modeltype,target_size, use_gpu);
+            // reap loaders that already finished
+            for (size_t i = 0; i < g_loaders.size(); )
+            {
+                if (*g_loaders[i].done)
+                {
+                    g_loaders[i].thread.join();
+                    g_loaders.erase(g_loaders.begin() + i);
+                }
+                else
+                {
+                    i++;
+                }
+            }
+
+            // the loader reads assets through mgr, keep the java asset manager alive until it is done
+            jobject asset_manager_ref = env->NewGlobalRef(assetManager);
+
+            ModelLoader loader;
+            loader.done = std::make_shared<std::atomic<bool> >(false);
+            std::shared_ptr<std::atomic<bool> > done = loader.done;
+
+            // load off the camera thread, the previous model keeps rendering until the swap
+            loader.thread = std::thread([=]() {
+                std::shared_ptr<Face> blazeface = std::make_shared<Face>();
+                blazeface->set_weighted_nms(true);
+                if (low_power)
+                {
+                    // little cores, and the detector samples the y plane only
+                    blazeface->set_detector_policy(StagePolicy(1));
+                    blazeface->set_landmark_policy(StagePolicy(1));
+                    blazeface->set_luma_detector(true);
+                }
+                if (blazeface->load(mgr, modeltype, target_size, use_gpu, true) != 0)
+                {
+                    // render the unsupported notice rather than keep the previous model
+                    __android_log_print(ANDROID_LOG_ERROR, "ncnn", "load %s failed", modeltype);
+                    blazeface.reset();
+                }
+
+                {
+                    ncnn::MutexLockGuard g(lock);
+
+                    // a newer request superseded this one
+                    if (generation == g_load_generation)
+                        std::atomic_store(&g_blazeface, blazeface);
+                }
+
+                JNIEnv* thread_env = 0;
+                g_vm->AttachCurrentThread(&thread_env, 0);
+                thread_env->DeleteGlobalRef(asset_manager_ref);
+                g_vm->DetachCurrentThread();
+
+                *done = true;
+            });
+
+            g_loaders.push_back(std::move(loader));
         }
     }
 
@@ -223,8 +360,13 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_blazefacencnn_BlazeFaceNcnn_openCame
     if (facing < 0 || facing > 1)
         return JNI_FALSE;
 
-    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "openCamera %d", facing);
+    int capture_width = 640;
+    int capture_height = 480;
+    capture_size_for_target(g_target_size, &capture_width, &capture_height);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "openCamera %d %dx%d", facing, capture_width, capture_height);
 
+    g_camera->set_capture_config(capture_width, capture_height);
     g_camera->open((int)facing);
 
     return JNI_TRUE;
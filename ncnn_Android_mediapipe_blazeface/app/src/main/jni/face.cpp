@@ -14,9 +14,19 @@
 
 #include "face.h"
 
+#include <float.h>
+#include <string.h>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+
+#include <android/log.h>
+
+#include "benchmark.h"
 #include "cpu.h"
+
+#include "imagewarp.h"
+#include "ssddetector.h"
 /*
 const int FACE_CONNECTIONS[][2] = {
         {61, 146}, {146, 91}, {91, 181}, {181, 84}, {84, 17},
@@ -505,97 +515,12 @@ const int FACEMESH_TESSELATION[][2] = {
         { 390, 339 }, { 339, 249 }, { 249, 390 }, { 339, 448 }, { 448, 255 }, { 255, 339 } };
 
 
-static inline float intersection_area(const Object& a, const Object& b)
-{
-    cv::Rect_<float> inter = a.rect & b.rect;
-    return inter.area();
-}
-
-static void qsort_descent_inplace(std::vector<Object>& faceobjects, int left, int right)
-{
-    int i = left;
-    int j = right;
-    float p = faceobjects[(left + right) / 2].score;
-
-    while (i <= j)
-    {
-        while (faceobjects[i].score > p)
-            i++;
-
-        while (faceobjects[j].score < p)
-            j--;
-
-        if (i <= j)
-        {
-            // swap
-            std::swap(faceobjects[i], faceobjects[j]);
-
-            i++;
-            j--;
-        }
-    }
-
-#pragma omp parallel sections
-    {
-#pragma omp section
-        {
-            if (left < j) qsort_descent_inplace(faceobjects, left, j);
-        }
-#pragma omp section
-        {
-            if (i < right) qsort_descent_inplace(faceobjects, i, right);
-        }
-    }
-}
-
-static void qsort_descent_inplace(std::vector<Object>& faceobjects)
-{
-    if (faceobjects.empty())
-        return;
-
-    qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
-}
-
-static void nms_sorted_bboxes(const std::vector<Object>& faceobjects, std::vector<int>& picked, float nms_threshold)
-{
-    picked.clear();
-
-    const int n = faceobjects.size();
-
-    std::vector<float> areas(n);
-    for (int i = 0; i < n; i++)
-    {
-        areas[i] = faceobjects[i].rect.area();
-    }
-
-    for (int i = 0; i < n; i++)
-    {
-        const Object& a = faceobjects[i];
-
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const Object& b = faceobjects[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            // float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
-        }
-
-        if (keep)
-            picked.push_back(i);
-    }
-}
-
 static inline float sigmoid(float x)
 {
     return static_cast<float>(1.f / (1.f + exp(-x)));
 }
 
-static void generate_proposals(const ncnn::Mat& anchors, int stride, const ncnn::Mat& in_pad, const ncnn::Mat& feat_blob, float prob_threshold, std::vector<Object>& objects)
+static void generate_proposals(const ncnn::Mat& anchors, int stride, const ncnn::Mat& in_pad, const ncnn::Mat& feat_blob, float prob_threshold, std::vector<DetectorProposal>& objects)
 {
     const int num_grid = feat_blob.h;
 
@@ -664,12 +589,12 @@ static void generate_proposals(const ncnn::Mat& anchors, int stride, const ncnn:
                     float x1 = pb_cx + pb_w * 0.5f;
                     float y1 = pb_cy + pb_h * 0.5f;
 
-                    Object obj;
+                    DetectorProposal obj;
                     obj.rect.x = x0;
                     obj.rect.y = y0;
                     obj.rect.width = x1 - x0;
                     obj.rect.height = y1 - y0;
-                    obj.score = confidence;
+                    obj.prob = confidence;
                     for (int l = 0; l < 5; l++)
                     {
                         float x = featptr[2 * l + 5] * anchor_w + j * stride;
@@ -682,6 +607,67 @@ static void generate_proposals(const ncnn::Mat& anchors, int stride, const ncnn:
         }
     }
 }
+// yolov5 blazeface, anchor boxes with five keypoints at strides 8 and 16
+class Yolov5DetectorBackend : public DetectorBackend
+{
+public:
+    virtual const char* name() const { return "blazeface"; }
+
+    virtual const char* input_name() const { return "data"; }
+
+    // yolov5/utils/datasets.py letterbox
+    virtual int pad_multiple() const { return 32; }
+
+    virtual const float* mean_values() const
+    {
+        static const float mean_vals[3] = {0.f, 0.f, 0.f};
+        return mean_vals;
+    }
+
+    virtual const float* norm_values() const
+    {
+        static const float norm_vals[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
+        return norm_vals;
+    }
+
+    virtual void decode(ncnn::Extractor& ex, const ncnn::Mat& in_pad, float prob_threshold, DetectorScratch& scratch) const
+    {
+        std::vector<DetectorProposal>& proposals = scratch.proposals;
+
+        // stride 8
+        {
+            ncnn::Mat out;
+            ex.extract("stride_8", out);
+
+            ncnn::Mat anchors(6);
+            anchors[0] = 5.f;
+            anchors[1] = 6.f;
+            anchors[2] = 10.f;
+            anchors[3] = 13.f;
+            anchors[4] = 21.f;
+            anchors[5] = 26.f;
+
+            generate_proposals(anchors, 8, in_pad, out, prob_threshold, proposals);
+        }
+
+        // stride 16
+        {
+            ncnn::Mat out;
+            ex.extract("stride_16", out);
+
+            ncnn::Mat anchors(6);
+            anchors[0] = 55.f;
+            anchors[1] = 72.f;
+            anchors[2] = 225.f;
+            anchors[3] = 304.f;
+            anchors[4] = 438.f;
+            anchors[5] = 553.f;
+
+            generate_proposals(anchors, 16, in_pad, out, prob_threshold, proposals);
+        }
+    }
+};
+
 static float normalize_radians(float angle)
 {
     return angle - 2 * M_PI * std::floor((angle - (-M_PI)) / (2 * M_PI));
@@ -763,152 +749,360 @@ static void compute_detect_to_roi(Object& obj, const int& target_size)
     }
 }
 
-int Face::detect(const cv::Mat& rgb, std::vector<Object>& objects,float prob_threshold, float nms_threshold)
+// upright square roi around a box, for detectors without keypoints to take a rotation from
+// scaled like the mediapipe detection to roi, the mesh then tracks the actual rotation
+static void compute_box_to_roi(Object& obj)
 {
-    int img_w = rgb.cols;
-    int img_h = rgb.rows;
-
-    // letterbox pad to multiple of 32
-    int w = img_w;
-    int h = img_h;
-    float scale = 1.f;
-    if (w > h)
+    float long_side = std::max(obj.rect.width, obj.rect.height);
+
+    obj.rotation = 0.f;
+    obj.cx = obj.rect.x + obj.rect.width * 0.5f;
+    obj.cy = obj.rect.y + obj.rect.height * 0.5f;
+    obj.w = long_side * 1.5f;
+    obj.h = long_side * 1.5f;
+
+    float dx = obj.w * 0.5f;
+    float dy = obj.h * 0.5f;
+
+    obj.pos[0] = cv::Point2f(obj.cx - dx, obj.cy - dy);
+    obj.pos[1] = cv::Point2f(obj.cx + dx, obj.cy - dy);
+    obj.pos[2] = cv::Point2f(obj.cx + dx, obj.cy + dy);
+    obj.pos[3] = cv::Point2f(obj.cx - dx, obj.cy + dy);
+}
+
+// affine taking upright pixels back into the w x h frame that kanna_rotate rotate_type brings upright
+static void upright_to_frame(int rotate_type, int w, int h, double* a)
+{
+    const double x1 = w - 1;
+    const double y1 = h - 1;
+
+    const double maps[8][6] = {
+        { 1, 0, 0, 0, 1, 0 },
+        { -1, 0, x1, 0, 1, 0 },
+        { -1, 0, x1, 0, -1, y1 },
+        { 1, 0, 0, 0, -1, y1 },
+        { 0, 1, 0, 1, 0, 0 },
+        { 0, 1, 0, -1, 0, y1 },
+        { 0, -1, x1, -1, 0, y1 },
+        { 0, -1, x1, 1, 0, 0 }
+    };
+
+    const double* m = maps[std::max(std::min(rotate_type, 8), 1) - 1];
+    for (int i = 0; i < 6; i++)
+    {
+        a[i] = m[i];
+    }
+}
+
+// affine from the landmark crop to upright frame pixels, and the same chained with
+// frame_m so the crop is sampled straight from the source frame
+static void compute_roi_affine(const Object& obj, const double* frame_m, cv::Mat& trans_mat, cv::Mat& sample_mat)
+{
+    cv::Point2f srcPts[4];
+    srcPts[0] = obj.pos[2];
+    srcPts[1] = obj.pos[3];
+    srcPts[2] = obj.pos[0];
+    srcPts[3] = obj.pos[1];
+
+    cv::Point2f dstPts[4];
+    dstPts[0] = cv::Point2f(0, 0);
+    dstPts[1] = cv::Point2f(192, 0);
+    dstPts[2] = cv::Point2f(192, 192);
+    dstPts[3] = cv::Point2f(0, 192);
+
+    cv::Mat crop_mat = cv::getAffineTransform(srcPts, dstPts);
+    cv::invertAffineTransform(crop_mat, trans_mat);
+
+    const cv::Mat& t = trans_mat;
+    sample_mat.create(2, 3, CV_64F);
+    for (int r = 0; r < 2; r++)
+    {
+        const double* fm = frame_m + r * 3;
+        sample_mat.at<double>(r, 0) = fm[0] * t.at<double>(0, 0) + fm[1] * t.at<double>(1, 0);
+        sample_mat.at<double>(r, 1) = fm[0] * t.at<double>(0, 1) + fm[1] * t.at<double>(1, 1);
+        sample_mat.at<double>(r, 2) = fm[0] * t.at<double>(0, 2) + fm[1] * t.at<double>(1, 2) + fm[2];
+    }
+}
+
+// rotated roi around the face mesh of the previous frame, like mediapipe landmarks to roi
+static void compute_landmark_to_roi(Object& obj)
+{
+    const std::vector<cv::Point2f>& pts = obj.skeleton;
+
+    // same axis as compute_rotation, eye corners against mouth corners
+    float x0 = (pts[33].x + pts[263].x) / 2;
+    float y0 = (pts[33].y + pts[263].y) / 2;
+    float x1 = (pts[61].x + pts[291].x) / 2;
+    float y1 = (pts[61].y + pts[291].y) / 2;
+
+    float target_angle = M_PI * 0.5f;
+    obj.rotation = normalize_radians(target_angle - std::atan2(-(y1 - y0), x1 - x0));
+
+    // bounds of the mesh in the face aligned frame
+    const cv::Point2f origin = pts[0];
+    float min_x = FLT_MAX;
+    float min_y = FLT_MAX;
+    float max_x = -FLT_MAX;
+    float max_y = -FLT_MAX;
+    float rect_x0 = FLT_MAX;
+    float rect_y0 = FLT_MAX;
+    float rect_x1 = -FLT_MAX;
+    float rect_y1 = -FLT_MAX;
+    for (size_t i = 0; i < pts.size(); i++)
     {
-        scale = (float)target_size / w;
-        w = target_size;
-        h = h * scale;
+        cv::Point2f p = pts[i] - origin;
+        rot_vec(p, -obj.rotation);
+        min_x = std::min(min_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_x = std::max(max_x, p.x);
+        max_y = std::max(max_y, p.y);
+
+        rect_x0 = std::min(rect_x0, pts[i].x);
+        rect_y0 = std::min(rect_y0, pts[i].y);
+        rect_x1 = std::max(rect_x1, pts[i].x);
+        rect_y1 = std::max(rect_y1, pts[i].y);
+    }
+
+    obj.rect = cv::Rect_<float>(rect_x0, rect_y0, rect_x1 - rect_x0, rect_y1 - rect_y0);
+
+    cv::Point2f center((min_x + max_x) * 0.5f, (min_y + max_y) * 0.5f);
+    rot_vec(center, obj.rotation);
+    center += origin;
+
+    float long_side = std::max(max_x - min_x, max_y - min_y);
+    obj.cx = center.x;
+    obj.cy = center.y;
+    obj.w = long_side * 1.5f;
+    obj.h = long_side * 1.5f;
+
+    float dx = obj.w * 0.5f;
+    float dy = obj.h * 0.5f;
+
+    obj.pos[0].x = -dx;  obj.pos[0].y = -dy;
+    obj.pos[1].x = +dx;  obj.pos[1].y = -dy;
+    obj.pos[2].x = +dx;  obj.pos[2].y = +dy;
+    obj.pos[3].x = -dx;  obj.pos[3].y = +dy;
+
+    for (int i = 0; i < 4; i++)
+    {
+        rot_vec(obj.pos[i], obj.rotation);
+        obj.pos[i] += center;
+    }
+}
+
+// small nets scale poorly across cores but faces are independent,
+// so with several faces run one single threaded landmark pass per worker
+template<typename Refine>
+static void refine_faces(int count, const StagePolicy& policy, const Refine& refine)
+{
+    const int num_workers = std::min(count, policy.num_threads());
+    if (num_workers > 1)
+    {
+        // the workers skip the policy, so the team they come from has to sit on the landmark cores
+        policy.bind();
+
+#pragma omp parallel for num_threads(num_workers)
+        for (int i = 0; i < count; i++)
+        {
+            refine(i, 1);
+        }
     }
     else
     {
-        scale = (float)target_size / h;
-        h = target_size;
-        w = w * scale;
+        for (int i = 0; i < count; i++)
+        {
+            refine(i, 0);
+        }
     }
+}
 
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, img_w, img_h,w, h);
+// upright to sensor frame mapping of a nv21 frame including the roi offset
+static void sensor_frame_affine(const SensorFrame& frame, double* frame_m)
+{
+    upright_to_frame(frame.rotate_type, frame.roi.width, frame.roi.height, frame_m);
+    frame_m[2] += frame.roi.x;
+    frame_m[5] += frame.roi.y;
+}
 
-    // pad to target_size rectangle
-    // yolov5/utils/datasets.py letterbox
-    int wpad = (w + 31) / 32 * 32 - w;
-    int hpad = (h + 31) / 32 * 32 - h;
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
+int Face::detect(const cv::Mat& rgb, std::vector<Object>& objects,float prob_threshold, float nms_threshold) const
+{
+    return detect(rgb, 1, objects, prob_threshold, nms_threshold);
+}
 
-    const float norm_vals[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
-    in_pad.substract_mean_normalize(0, norm_vals);
+int Face::detect(const cv::Mat& rgb, int rotate_type, std::vector<Object>& objects, float prob_threshold, float nms_threshold) const
+{
+    // upright size, types 5-8 swap the axes
+    const bool transposed = rotate_type >= 5;
+    int img_w = transposed ? rgb.rows : rgb.cols;
+    int img_h = transposed ? rgb.cols : rgb.rows;
+
+    // long side to target_size, detect_rois pads to the detector stride
+    int w;
+    int h;
+    float scale = letterbox_scale(img_w, img_h, target_size, w, h);
+
+    ncnn::Mat in;
+    if (rotate_type == 1)
+    {
+        in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, img_w, img_h,w, h);
+    }
+    else
+    {
+        // shrink first, then only the small detector input gets rotated
+        const int rw = transposed ? h : w;
+        const int rh = transposed ? w : h;
+        cv::Mat resized(rh, rw, CV_8UC3);
+        ncnn::resize_bilinear_c3(rgb.data, rgb.cols, rgb.rows, resized.data, rw, rh);
+
+        cv::Mat upright(h, w, CV_8UC3);
+        ncnn::kanna_rotate_c3(resized.data, rw, rh, upright.data, w, h, rotate_type);
+
+        in = ncnn::Mat::from_pixels(upright.data, ncnn::Mat::PIXEL_RGB, w, h);
+    }
 
-    ncnn::Extractor ex = blazepalm_net.create_extractor();
+    in.substract_mean_normalize(detector_backend->mean_values(), detector_backend->norm_values());
 
-    ex.input("data", in_pad);
+    detect_rois(in, scale, img_w, img_h, objects, prob_threshold, nms_threshold);
 
-    std::vector<Object> proposals;
+    double frame_m[6];
+    upright_to_frame(rotate_type, rgb.cols, rgb.rows, frame_m);
 
-    // stride 8
+    const int count = objects.size();
+    std::vector<cv::Mat> trans_mats(count);
+    std::vector<cv::Mat> sample_mats(count);
+    for (int i = 0; i < count; i++)
     {
-        ncnn::Mat out;
-        ex.extract("stride_8", out);
+        compute_roi_affine(objects[i], frame_m, trans_mats[i], sample_mats[i]);
+    }
 
-        ncnn::Mat anchors(6);
-        anchors[0] = 5.f;
-        anchors[1] = 6.f;
-        anchors[2] = 10.f;
-        anchors[3] = 13.f;
-        anchors[4] = 21.f;
-        anchors[5] = 26.f;
+    refine_faces(count, landmark.stage_policy(), [&](int i, int num_threads) {
+        landmark.detect(rgb, sample_mats[i], trans_mats[i], objects[i].skeleton, objects[i].left_eyes, objects[i].right_eyes, num_threads);
+    });
 
-        std::vector<Object> objects8;
-        generate_proposals(anchors, 8, in, out, prob_threshold, objects8);
+    return 0;
+}
 
-        proposals.insert(proposals.end(), objects8.begin(), objects8.end());
+int Face::detect(const SensorFrame& frame, std::vector<Object>& objects, float prob_threshold, float nms_threshold) const
+{
+    const bool transposed = frame.rotate_type >= 5;
+    int img_w = transposed ? frame.roi.height : frame.roi.width;
+    int img_h = transposed ? frame.roi.width : frame.roi.height;
+
+    // long side to target_size, detect_rois pads to the detector stride
+    int w;
+    int h;
+    float scale = letterbox_scale(img_w, img_h, target_size, w, h);
+
+    double frame_m[6];
+    sensor_frame_affine(frame, frame_m);
+
+    // low resolution pass, detector pixels map to upright pixel centers then into the sensor frame
+    const float inv_scale = 1.f / scale;
+    const float offset = 0.5f * inv_scale - 0.5f;
+    const float m[6] = {
+        (float)frame_m[0] * inv_scale, (float)frame_m[1] * inv_scale, (float)(frame_m[0] * offset + frame_m[1] * offset + frame_m[2]),
+        (float)frame_m[3] * inv_scale, (float)frame_m[4] * inv_scale, (float)(frame_m[3] * offset + frame_m[4] * offset + frame_m[5])
+    };
+
+    const float* mean_vals = detector_backend->mean_values();
+    const float* norm_vals = detector_backend->norm_values();
+
+    ncnn::Mat in;
+    if (luma_detector)
+    {
+        warp_affine_normalize_luma(frame.nv21, frame.width, frame.height, m, w, h, mean_vals, norm_vals, in);
+    }
+    else
+    {
+        warp_affine_normalize_nv21(frame.nv21, frame.width, frame.height, m, w, h, mean_vals, norm_vals, in);
     }
 
-    // stride 16
+    detect_rois(in, scale, img_w, img_h, objects, prob_threshold, nms_threshold);
+
+    refine(frame, frame_m, objects);
+
+    return 0;
+}
+
+int Face::track(const SensorFrame& frame, std::vector<Object>& objects) const
+{
+    const bool transposed = frame.rotate_type >= 5;
+    const float img_w = transposed ? frame.roi.height : frame.roi.width;
+    const float img_h = transposed ? frame.roi.width : frame.roi.height;
+
+    // follow each face from its previous mesh, drop the ones that left the frame or collapsed
+    std::vector<Object> tracked;
+    tracked.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); i++)
     {
-        ncnn::Mat out;
-        ex.extract("stride_16", out);
+        Object& obj = objects[i];
+        if (obj.skeleton.size() != 468)
+            continue;
 
-        ncnn::Mat anchors(6);
-        anchors[0] = 55.f;
-        anchors[1] = 72.f;
-        anchors[2] = 225.f;
-        anchors[3] = 304.f;
-        anchors[4] = 438.f;
-        anchors[5] = 553.f;
+        compute_landmark_to_roi(obj);
 
-        std::vector<Object> objects16;
-        generate_proposals(anchors, 16, in, out, prob_threshold, objects16);
+        if (obj.cx < 0 || obj.cy < 0 || obj.cx >= img_w || obj.cy >= img_h || obj.w < 16)
+            continue;
 
-        proposals.insert(proposals.end(), objects16.begin(), objects16.end());
+        tracked.push_back(obj);
     }
 
+    objects.swap(tracked);
 
-    // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(proposals);
+    double frame_m[6];
+    sensor_frame_affine(frame, frame_m);
 
-    // apply nms with nms_threshold
-    std::vector<int> picked;
-    nms_sorted_bboxes(proposals, picked, nms_threshold);
+    refine(frame, frame_m, objects);
 
-    int count = picked.size();
+    return 0;
+}
 
-    objects.resize(count);
+void Face::refine(const SensorFrame& frame, const double* frame_m, std::vector<Object>& objects) const
+{
+    const int count = objects.size();
+    std::vector<cv::Mat> trans_mats(count);
+    std::vector<cv::Mat> sample_mats(count);
     for (int i = 0; i < count; i++)
     {
-        objects[i] = proposals[picked[i]];
-
-        // adjust offset to original unpadded
-        float x0 = (objects[i].rect.x - (wpad / 2)) / scale;
-        float y0 = (objects[i].rect.y - (hpad / 2)) / scale;
-        float x1 = (objects[i].rect.x + objects[i].rect.width - (wpad / 2)) / scale;
-        float y1 = (objects[i].rect.y + objects[i].rect.height - (hpad / 2)) / scale;
-        for (int j = 0; j < 5; j++)
+        compute_roi_affine(objects[i], frame_m, trans_mats[i], sample_mats[i]);
+    }
+
+    refine_faces(count, landmark.stage_policy(), [&](int i, int num_threads) {
+        landmark.detect(frame.nv21, frame.width, frame.height, sample_mats[i], trans_mats[i], objects[i].skeleton, objects[i].left_eyes, objects[i].right_eyes, num_threads);
+    });
+}
+
+// in is the normalized upright detector input at scale, objects get rois in upright frame pixels
+int Face::detect_rois(const ncnn::Mat& in, float scale, int img_w, int img_h, std::vector<Object>& objects, float prob_threshold, float nms_threshold) const
+{
+    InferenceContextGuard ctx(contexts);
+
+    ncnn::Extractor ex = blazepalm->net.create_extractor();
+    ex.set_blob_allocator(&ctx->blob_pool_allocator);
+    ex.set_workspace_allocator(&ctx->workspace_pool_allocator);
+    detector_policy.apply(ex);
+
+    std::vector<DetectorProposal> faces;
+    detect_faces(*detector_backend, ex, in, scale, img_w, img_h, prob_threshold, nms_threshold, weighted_nms, max_faces, ctx->detector_scratch, faces);
+
+    objects.clear();
+    objects.resize(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        Object& obj = objects[i];
+        obj.rect = faces[i].rect;
+        obj.label = 0;
+        obj.score = faces[i].prob;
+        obj.pts = faces[i].pts;
+
+        if (obj.pts.empty())
         {
-            float ptx = (objects[i].pts[j].x - (wpad / 2)) / scale;
-            float pty = (objects[i].pts[j].y - (hpad / 2)) / scale;
-            objects[i].pts[j] = cv::Point2f(ptx, pty);
+            compute_box_to_roi(obj);
+            continue;
         }
 
-        // clip
-        x0 = std::max(std::min(x0, (float)(img_w - 1)), 0.f);
-        y0 = std::max(std::min(y0, (float)(img_h - 1)), 0.f);
-        x1 = std::max(std::min(x1, (float)(img_w - 1)), 0.f);
-        y1 = std::max(std::min(y1, (float)(img_h - 1)), 0.f);
-
-        objects[i].rect.x = x0;
-        objects[i].rect.y = y0;
-        objects[i].rect.width = x1 - x0;
-        objects[i].rect.height = y1 - y0;
-
-        compute_rotation(objects[i]);
-        compute_detect_to_roi(objects[i], target_size);
-        objects[i].pos[0].x = (objects[i].pos[0].x - (wpad / 2));
-        objects[i].pos[0].y = (objects[i].pos[0].y - (hpad / 2));
-        objects[i].pos[1].x = (objects[i].pos[1].x - (wpad / 2));
-        objects[i].pos[1].y = (objects[i].pos[1].y - (hpad / 2));
-        objects[i].pos[2].x = (objects[i].pos[2].x - (wpad / 2));
-        objects[i].pos[2].y = (objects[i].pos[2].y - (hpad / 2));
-        objects[i].pos[3].x = (objects[i].pos[3].x - (wpad / 2));
-        objects[i].pos[3].y = (objects[i].pos[3].y - (hpad / 2));
-
-        cv::Point2f srcPts[4];
-        srcPts[0] = objects[i].pos[2];
-        srcPts[1] = objects[i].pos[3];
-        srcPts[2] = objects[i].pos[0];
-        srcPts[3] = objects[i].pos[1];
-
-        cv::Point2f dstPts[4];
-        dstPts[0] = cv::Point2f(0, 0);
-        dstPts[1] = cv::Point2f(192, 0);
-        dstPts[2] = cv::Point2f(192, 192);
-        dstPts[3] = cv::Point2f(0, 192);
-
-        cv::Mat trans_mat = cv::getAffineTransform(srcPts, dstPts);
-        cv::warpAffine(rgb, objects[i].trans_image, trans_mat, cv::Size(192, 192), 1, 0);
-
-        cv::Mat trans_mat_inv;
-        cv::invertAffineTransform(trans_mat, trans_mat_inv);
-
-        landmark.detect(objects[i].trans_image, trans_mat_inv, objects[i].skeleton, objects[i].left_eyes,objects[i].right_eyes);
+        compute_rotation(obj);
+        compute_detect_to_roi(obj, target_size);
     }
 
     return 0;
@@ -916,51 +1110,98 @@ int Face::detect(const cv::Mat& rgb, std::vector<Object>& objects,float prob_thr
 
 Face::Face()
 {
-    blob_pool_allocator.set_size_compare_ratio(0.f);
-    workspace_pool_allocator.set_size_compare_ratio(0.f);
+    luma_detector = false;
+    max_faces = 0;
+    weighted_nms = false;
 }
 
+int Face::load(AAssetManager* mgr, const char* modeltype, int _target_size, bool use_gpu, bool _warmup)
+{
+    contexts.clear();
+
+    blazepalm = ModelRegistry::get(mgr, modeltype, use_gpu);
+    if (!blazepalm)
+        return -1;
+
+    if (strcmp(modeltype, "paddle_blazeface") == 0)
+        detector_backend = std::make_shared<SsdDetectorBackend>();
+    else
+        detector_backend = std::make_shared<Yolov5DetectorBackend>();
+
+    if (landmark.load(mgr,"face_landmark_with_attention") != 0)
+        return -1;
+
+    target_size = _target_size;
+
+    if (_warmup)
+        warmup();
+
+    return 0;
+}
 
-int Face::load(AAssetManager* mgr, const char* modeltype, int _target_size, bool use_gpu)
+int Face::warmup()
 {
-    blazepalm_net.clear();
-    blob_pool_allocator.clear();
-    workspace_pool_allocator.clear();
+    double t0 = ncnn::get_current_time();
+
+    // the square target is the largest letterboxed input, so the pools cover any frame shape
+    {
+        InferenceContextGuard ctx(contexts);
 
-    ncnn::set_cpu_powersave(2);
-    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
+        ncnn::Mat in_pad(target_size, target_size, 3);
+        in_pad.fill(0.5f);
 
-    blazepalm_net.opt = ncnn::Option();
-#if NCNN_VULKAN
-    blazepalm_net.opt.use_vulkan_compute = use_gpu;
-#endif
+        ncnn::Extractor ex = blazepalm->net.create_extractor();
+        ex.set_blob_allocator(&ctx->blob_pool_allocator);
+        ex.set_workspace_allocator(&ctx->workspace_pool_allocator);
+        detector_policy.apply(ex);
 
-    blazepalm_net.opt.num_threads = ncnn::get_big_cpu_count();
-    blazepalm_net.opt.blob_allocator = &blob_pool_allocator;
-    blazepalm_net.opt.workspace_allocator = &workspace_pool_allocator;
+        ex.input(detector_backend->input_name(), in_pad);
 
-    char parampath[256];
-    char modelpath[256];
-    sprintf(parampath, "%s.param", modeltype);
-    sprintf(modelpath, "%s.bin", modeltype);
+        // nothing scores above 1, only the outputs get computed
+        detector_backend->decode(ex, in_pad, 1.f, ctx->detector_scratch);
+    }
 
-    blazepalm_net.load_param(mgr, parampath);
-    blazepalm_net.load_model(mgr, modelpath);
+    double t1 = ncnn::get_current_time();
 
-    landmark.load(mgr,"face_landmark_with_attention");
+    landmark.warmup();
 
-    target_size = _target_size;
+    double t2 = ncnn::get_current_time();
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "warmup %s %d detector %.2fms landmark %.2fms (%d threads)", detector_backend->name(), target_size, t1 - t0, t2 - t1, detector_policy.num_threads());
 
     return 0;
 }
 
 
+void Face::set_detector_policy(const StagePolicy& policy)
+{
+    detector_policy = policy;
+}
+
+void Face::set_landmark_policy(const StagePolicy& policy)
+{
+    landmark.set_policy(policy);
+}
+
+void Face::set_luma_detector(bool enable)
+{
+    luma_detector = enable;
+}
+
+void Face::set_max_faces(int count)
+{
+    max_faces = count;
+}
+
+void Face::set_weighted_nms(bool enable)
+{
+    weighted_nms = enable;
+}
+
 int Face::draw(cv::Mat& rgb, const std::vector<Object>& objects)
 {
     for (int i = 0; i < objects.size(); i++)
     {
-        objects[i].trans_image.copyTo(rgb(cv::Rect(0,0,192,192)));
-
         for(int j = 0; j < 468; j++)
             cv::circle(rgb, objects[i].skeleton[j], 2, cv::Scalar(0,255,255),-1);
         for (int j = 0; j < 8; j++)
@@ -18,6 +18,10 @@
 #include <opencv2/core/core.hpp>
 #include <net.h>
 #include "landmark.h"
+#include "modelregistry.h"
+#include "facedetector.h"
+#include "stagepolicy.h"
+
 struct Object
 {
     cv::Rect_<float> rect;
@@ -30,32 +34,76 @@ struct Object
     float  w;
     float  h;
     cv::Point2f  pos[4];
-    cv::Mat trans_image;
     std::vector<cv::Point2f> skeleton;
     std::vector<cv::Point2f> left_eyes;
     std::vector<cv::Point2f> right_eyes;
 };
 
+// camera nv21 frame in sensor orientation, roi is the even aligned part that rotate_type brings upright
+struct SensorFrame
+{
+    const unsigned char* nv21;
+    int width;
+    int height;
+    cv::Rect roi;
+    int rotate_type;
+};
+
+// detect may be called from several threads at once, each call borrows its own allocator context
 class Face
 {
 public:
     Face();
 
-    int load(AAssetManager* mgr, const char* modeltype, int target_size, bool use_gpu = false);
+    // modeltype picks the detector backend, paddle_blazeface has no keypoints so its rois are upright boxes
+    // warmup runs dummy inferences at target_size so the first frame does not pay for allocation
+    int load(AAssetManager* mgr, const char* modeltype, int target_size, bool use_gpu = false, bool warmup = false);
+
+    int detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.55f, float nms_threshold = 0.3f) const;
+
+    // rgb is the unrotated sensor frame and rotate_type the ncnn::kanna_rotate type that brings it upright,
+    // objects are reported in upright coordinates without rotating the frame itself
+    int detect(const cv::Mat& rgb, int rotate_type, std::vector<Object>& objects, float prob_threshold = 0.55f, float nms_threshold = 0.3f) const;
 
-    int detect(const cv::Mat& rgb, std::vector<Object>& objects, float prob_threshold = 0.55f, float nms_threshold = 0.3f);
+    // nv21 input, the detector gets a low resolution pass and the landmark crops are sampled
+    // straight from the frame so it is never converted to rgb as a whole
+    int detect(const SensorFrame& frame, std::vector<Object>& objects, float prob_threshold = 0.55f, float nms_threshold = 0.3f) const;
+
+    // landmark pass only, each roi is re-derived from the mesh the object carries from the previous frame
+    // and faces whose roi left the frame are dropped
+    int track(const SensorFrame& frame, std::vector<Object>& objects) const;
 
     int draw(cv::Mat& rgb, const std::vector<Object>& objects);
 
+    // configure before detect, e.g. detector on big cores and landmark refinement on little cores
+    void set_detector_policy(const StagePolicy& policy);
+    void set_landmark_policy(const StagePolicy& policy);
+
+    // low power mode, the nv21 detector pass reads only the y plane and feeds it as gray
+    void set_luma_detector(bool enable);
+
+    // keep at most count faces after nms, 0 for no limit
+    void set_max_faces(int count);
+
+    // blend overlapping detections by score instead of dropping them, steadier rois for tracking
+    void set_weighted_nms(bool enable);
+
 private:
+    int warmup();
+
+    int detect_rois(const ncnn::Mat& in, float scale, int img_w, int img_h, std::vector<Object>& objects, float prob_threshold, float nms_threshold) const;
+    void refine(const SensorFrame& frame, const double* frame_m, std::vector<Object>& objects) const;
 
-    ncnn::Net blazepalm_net;
+    std::shared_ptr<const SharedNet> blazepalm;
     LandmarkDetect landmark;
     int target_size;
-    float mean_vals[3];
-    float norm_vals[3];
-    ncnn::UnlockedPoolAllocator blob_pool_allocator;
-    ncnn::PoolAllocator workspace_pool_allocator;
+    StagePolicy detector_policy;
+    bool luma_detector;
+    int max_faces;
+    bool weighted_nms;
+    // decoder of the loaded detector net, letterbox and nms are shared by every backend
+    std::shared_ptr<const DetectorBackend> detector_backend;
+    mutable InferenceContextPool contexts;
 };
 
 #endif // FACE_H
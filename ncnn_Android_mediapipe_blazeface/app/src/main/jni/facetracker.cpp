@@ -0,0 +1,66 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "facetracker.h"
+
+#include <android/log.h>
+
+FaceTracker::FaceTracker()
+{
+    redetect_interval = 10;
+    reset();
+}
+
+void FaceTracker::set_redetect_interval(int interval)
+{
+    redetect_interval = interval;
+}
+
+void FaceTracker::reset()
+{
+    tracks.clear();
+    frames_since_detect = 0;
+    frame_count = 0;
+    detect_count = 0;
+}
+
+int FaceTracker::update(const Face& face, const SensorFrame& frame, std::vector<Object>& objects)
+{
+    if (!tracks.empty() && frames_since_detect + 1 < redetect_interval)
+    {
+        face.track(frame, tracks);
+        frames_since_detect++;
+    }
+    else
+    {
+        tracks.clear();
+    }
+
+    if (tracks.empty())
+    {
+        face.detect(frame, tracks);
+        frames_since_detect = 0;
+        detect_count++;
+    }
+
+    frame_count++;
+    if (frame_count % 300 == 0)
+    {
+        __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "tracker %d frames %d detections", frame_count, detect_count);
+    }
+
+    objects = tracks;
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef FACETRACKER_H
+#define FACETRACKER_H
+
+#include <vector>
+
+#include "face.h"
+
+// follows faces across frames from their meshes, the detector only runs
+// when nothing is tracked or every redetect_interval frames to pick up new faces
+//
+// not thread safe, keep one tracker per camera stream
+class FaceTracker
+{
+public:
+    FaceTracker();
+
+    void set_redetect_interval(int interval);
+    void reset();
+
+    int update(const Face& face, const SensorFrame& frame, std::vector<Object>& objects);
+
+    int frames() const { return frame_count; }
+    int detections() const { return detect_count; }
+
+private:
+    std::vector<Object> tracks;
+    int redetect_interval;
+    int frames_since_detect;
+    int frame_count;
+    int detect_count;
+};
+
+#endif // FACETRACKER_H
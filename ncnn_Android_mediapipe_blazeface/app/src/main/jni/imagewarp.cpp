@@ -0,0 +1,217 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "imagewarp.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+void warp_affine_normalize(const cv::Mat& rgb, const float* m, int target_w, int target_h,
+        const float* mean_vals, const float* norm_vals, ncnn::Mat& in)
+{
+    in.create(target_w, target_h, 3);
+
+    const int src_w = rgb.cols;
+    const int src_h = rgb.rows;
+    const int src_stride = (int)rgb.step;
+    const unsigned char* src = rgb.data;
+
+    float* outptr0 = in.channel(0);
+    float* outptr1 = in.channel(1);
+    float* outptr2 = in.channel(2);
+
+    for (int y = 0; y < target_h; y++)
+    {
+        const float row_x = m[1] * y + m[2];
+        const float row_y = m[4] * y + m[5];
+
+        for (int x = 0; x < target_w; x++)
+        {
+            const float sx = m[0] * x + row_x;
+            const float sy = m[3] * x + row_y;
+
+            const int x0 = (int)floorf(sx);
+            const int y0 = (int)floorf(sy);
+            const float fx = sx - x0;
+            const float fy = sy - y0;
+
+            float v[3] = { 0.f, 0.f, 0.f };
+            if (x0 >= 0 && y0 >= 0 && x0 + 1 < src_w && y0 + 1 < src_h)
+            {
+                const unsigned char* p0 = src + y0 * src_stride + x0 * 3;
+                const unsigned char* p1 = p0 + src_stride;
+                const float w00 = (1.f - fx) * (1.f - fy);
+                const float w01 = fx * (1.f - fy);
+                const float w10 = (1.f - fx) * fy;
+                const float w11 = fx * fy;
+                for (int k = 0; k < 3; k++)
+                {
+                    v[k] = p0[k] * w00 + p0[3 + k] * w01 + p1[k] * w10 + p1[3 + k] * w11;
+                }
+            }
+            else if (x0 >= -1 && y0 >= -1 && x0 < src_w && y0 < src_h)
+            {
+                // partially outside, taps beyond the frame read as zero
+                for (int ty = 0; ty < 2; ty++)
+                {
+                    const int yy = y0 + ty;
+                    if (yy < 0 || yy >= src_h)
+                        continue;
+
+                    const float wy = ty ? fy : 1.f - fy;
+                    for (int tx = 0; tx < 2; tx++)
+                    {
+                        const int xx = x0 + tx;
+                        if (xx < 0 || xx >= src_w)
+                            continue;
+
+                        const float w = wy * (tx ? fx : 1.f - fx);
+                        const unsigned char* p = src + yy * src_stride + xx * 3;
+                        v[0] += p[0] * w;
+                        v[1] += p[1] * w;
+                        v[2] += p[2] * w;
+                    }
+                }
+            }
+
+            *outptr0++ = (v[0] - mean_vals[0]) * norm_vals[0];
+            *outptr1++ = (v[1] - mean_vals[1]) * norm_vals[1];
+            *outptr2++ = (v[2] - mean_vals[2]) * norm_vals[2];
+        }
+    }
+}
+
+// bilinear luma tap at (x0 + fx, y0 + fy), taps beyond the frame read as zero
+static inline float sample_luma(const unsigned char* yptr, int src_w, int src_h, int x0, int y0, float fx, float fy)
+{
+    if (x0 >= 0 && y0 >= 0 && x0 + 1 < src_w && y0 + 1 < src_h)
+    {
+        const unsigned char* p0 = yptr + y0 * src_w + x0;
+        const unsigned char* p1 = p0 + src_w;
+        return (p0[0] * (1.f - fx) + p0[1] * fx) * (1.f - fy) + (p1[0] * (1.f - fx) + p1[1] * fx) * fy;
+    }
+
+    float luma = 0.f;
+    for (int ty = 0; ty < 2; ty++)
+    {
+        const int yy = y0 + ty;
+        if (yy < 0 || yy >= src_h)
+            continue;
+
+        const float wy = ty ? fy : 1.f - fy;
+        for (int tx = 0; tx < 2; tx++)
+        {
+            const int xx = x0 + tx;
+            if (xx < 0 || xx >= src_w)
+                continue;
+
+            luma += yptr[yy * src_w + xx] * wy * (tx ? fx : 1.f - fx);
+        }
+    }
+
+    return luma;
+}
+
+void warp_affine_normalize_nv21(const unsigned char* nv21, int nv21_width, int nv21_height, const float* m, int target_w, int target_h,
+        const float* mean_vals, const float* norm_vals, ncnn::Mat& in)
+{
+    in.create(target_w, target_h, 3);
+
+    const int src_w = nv21_width;
+    const int src_h = nv21_height;
+    const unsigned char* yptr = nv21;
+    const unsigned char* vuptr = nv21 + src_w * src_h;
+
+    float* outptr0 = in.channel(0);
+    float* outptr1 = in.channel(1);
+    float* outptr2 = in.channel(2);
+
+    for (int y = 0; y < target_h; y++)
+    {
+        const float row_x = m[1] * y + m[2];
+        const float row_y = m[4] * y + m[5];
+
+        for (int x = 0; x < target_w; x++)
+        {
+            const float sx = m[0] * x + row_x;
+            const float sy = m[3] * x + row_y;
+
+            const int x0 = (int)floorf(sx);
+            const int y0 = (int)floorf(sy);
+            const float fx = sx - x0;
+            const float fy = sy - y0;
+
+            float v[3] = { 0.f, 0.f, 0.f };
+            if (x0 >= -1 && y0 >= -1 && x0 < src_w && y0 < src_h)
+            {
+                const float luma = sample_luma(yptr, src_w, src_h, x0, y0, fx, fy);
+
+                // chroma is shared by each 2x2 block, take the nearest one like yuv420sp2rgb does
+                const int cx = std::min(std::max((int)(sx + 0.5f), 0), src_w - 1) / 2;
+                const int cy = std::min(std::max((int)(sy + 0.5f), 0), src_h - 1) / 2;
+                const unsigned char* vu = vuptr + cy * src_w + cx * 2;
+                const float dv = vu[0] - 128.f;
+                const float du = vu[1] - 128.f;
+
+                // same coefficients as ncnn::yuv420sp2rgb
+                v[0] = std::min(std::max(luma + 1.40625f * dv, 0.f), 255.f);
+                v[1] = std::min(std::max(luma - 0.71875f * dv - 0.34375f * du, 0.f), 255.f);
+                v[2] = std::min(std::max(luma + 1.765625f * du, 0.f), 255.f);
+            }
+
+            *outptr0++ = (v[0] - mean_vals[0]) * norm_vals[0];
+            *outptr1++ = (v[1] - mean_vals[1]) * norm_vals[1];
+            *outptr2++ = (v[2] - mean_vals[2]) * norm_vals[2];
+        }
+    }
+}
+
+void warp_affine_normalize_luma(const unsigned char* nv21, int nv21_width, int nv21_height, const float* m, int target_w, int target_h,
+        const float* mean_vals, const float* norm_vals, ncnn::Mat& in)
+{
+    in.create(target_w, target_h, 3);
+
+    const int src_w = nv21_width;
+    const int src_h = nv21_height;
+
+    float* outptr0 = in.channel(0);
+    float* outptr1 = in.channel(1);
+    float* outptr2 = in.channel(2);
+
+    for (int y = 0; y < target_h; y++)
+    {
+        const float row_x = m[1] * y + m[2];
+        const float row_y = m[4] * y + m[5];
+
+        for (int x = 0; x < target_w; x++)
+        {
+            const float sx = m[0] * x + row_x;
+            const float sy = m[3] * x + row_y;
+
+            const int x0 = (int)floorf(sx);
+            const int y0 = (int)floorf(sy);
+
+            float luma = 0.f;
+            if (x0 >= -1 && y0 >= -1 && x0 < src_w && y0 < src_h)
+            {
+                luma = sample_luma(nv21, src_w, src_h, x0, y0, sx - x0, sy - y0);
+            }
+
+            *outptr0++ = (luma - mean_vals[0]) * norm_vals[0];
+            *outptr1++ = (luma - mean_vals[1]) * norm_vals[1];
+            *outptr2++ = (luma - mean_vals[2]) * norm_vals[2];
+        }
+    }
+}
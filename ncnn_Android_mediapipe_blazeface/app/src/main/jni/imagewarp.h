@@ -0,0 +1,36 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef IMAGEWARP_H
+#define IMAGEWARP_H
+
+#include <opencv2/core/core.hpp>
+
+#include <mat.h>
+
+// m is the 2x3 affine taking output pixels to source pixels, samples are bilinear
+// and taps outside the source read as zero, output is planar float with (v - mean) * norm applied
+
+void warp_affine_normalize(const cv::Mat& rgb, const float* m, int target_w, int target_h,
+        const float* mean_vals, const float* norm_vals, ncnn::Mat& in);
+
+// same straight from a nv21 frame, only the sampled pixels are converted to rgb
+void warp_affine_normalize_nv21(const unsigned char* nv21, int nv21_width, int nv21_height, const float* m, int target_w, int target_h,
+        const float* mean_vals, const float* norm_vals, ncnn::Mat& in);
+
+// gray input from the y plane alone, replicated into all three channels with their own mean and norm
+void warp_affine_normalize_luma(const unsigned char* nv21, int nv21_width, int nv21_height, const float* m, int target_w, int target_h,
+        const float* mean_vals, const float* norm_vals, ncnn::Mat& in);
+
+#endif // IMAGEWARP_H
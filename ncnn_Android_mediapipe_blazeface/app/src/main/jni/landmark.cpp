@@ -14,12 +14,19 @@
 
 #include "landmark.h"
 
+#include <float.h>
 #include <string.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "cpu.h"
 
+#include "imagewarp.h"
+
+#if __ARM_NEON
+#include <arm_neon.h>
+#endif // __ARM_NEON
+
 float2 read3DLandmarkXY(const float* data, int idx)
 {
     float2 result;
@@ -51,48 +58,78 @@ void estimateRotationRadians(const float* input_data_0, int left_rotation_idx,in
     *rotation_radians = rotation;
 }
 
-void estimateCenterAndSize(const float* input_data_0,std::vector<int> subset_idxs,float rotation_radians,
+void estimateCenterAndSize(const float* input_data_0, const std::vector<int>& subset_idxs, float rotation_radians,
         float* crop_x, float* crop_y, float* crop_width, float* crop_height)
  {
-    std::vector<float3> landmarks;
-    landmarks.reserve(subset_idxs.size());
-    for (int i = 0; i < subset_idxs.size(); i++)
+    const float cos_r = std::cos(rotation_radians);
+    const float sin_r = std::sin(rotation_radians);
+    const int count = subset_idxs.size();
+    const int* idxs = subset_idxs.data();
+
+    // rotate every subset landmark and track the bounding box in one pass,
+    // the 0.25 landmark scale is applied once to the final extents
+    float min_x = FLT_MAX;
+    float min_y = FLT_MAX;
+    float max_x = -FLT_MAX;
+    float max_y = -FLT_MAX;
+
+    int i = 0;
+#if __ARM_NEON
+    float32x4_t _min_x = vdupq_n_f32(FLT_MAX);
+    float32x4_t _min_y = vdupq_n_f32(FLT_MAX);
+    float32x4_t _max_x = vdupq_n_f32(-FLT_MAX);
+    float32x4_t _max_y = vdupq_n_f32(-FLT_MAX);
+    const float32x4_t _cos_r = vdupq_n_f32(cos_r);
+    const float32x4_t _sin_r = vdupq_n_f32(sin_r);
+    for (; i + 3 < count; i += 4)
     {
-        landmarks.push_back(read3DLandmarkXYZ(input_data_0, subset_idxs[i]));
+        float xs[4];
+        float ys[4];
+        for (int k = 0; k < 4; k++)
+        {
+            xs[k] = input_data_0[idxs[i + k] * 3];
+            ys[k] = input_data_0[idxs[i + k] * 3 + 1];
+        }
+        float32x4_t _x = vld1q_f32(xs);
+        float32x4_t _y = vld1q_f32(ys);
+        float32x4_t _rx = vmlsq_f32(vmulq_f32(_cos_r, _x), _sin_r, _y);
+        float32x4_t _ry = vmlaq_f32(vmulq_f32(_sin_r, _x), _cos_r, _y);
+        _min_x = vminq_f32(_min_x, _rx);
+        _min_y = vminq_f32(_min_y, _ry);
+        _max_x = vmaxq_f32(_max_x, _rx);
+        _max_y = vmaxq_f32(_max_y, _ry);
     }
-    for (int i = 0; i < landmarks.size(); i++)
     {
-        landmarks[i].z = 1.0;
+        float tmp[4];
+        vst1q_f32(tmp, _min_x);
+        for (int k = 0; k < 4; k++) min_x = std::min(min_x, tmp[k]);
+        vst1q_f32(tmp, _min_y);
+        for (int k = 0; k < 4; k++) min_y = std::min(min_y, tmp[k]);
+        vst1q_f32(tmp, _max_x);
+        for (int k = 0; k < 4; k++) max_x = std::max(max_x, tmp[k]);
+        vst1q_f32(tmp, _max_y);
+        for (int k = 0; k < 4; k++) max_y = std::max(max_y, tmp[k]);
     }
-    const float& r = rotation_radians;
-    const Mat3 t_rotation = Mat3(std::cos(r), -std::sin(r), 0.0,
-                                 std::sin(r), std::cos(r), 0.0,
-                                 0.0, 0.0, 1.0);
-    const Mat3 t_rotation_inverse =
-            Mat3(std::cos(-r), -std::sin(-r), 0.0,
-                 std::sin(-r), std::cos(-r), 0.0,
-                 0.0, 0.0, 1.0);
-    for (int i = 0; i < landmarks.size(); i++)
+#endif // __ARM_NEON
+    for (; i < count; i++)
     {
-        landmarks[i] = t_rotation * landmarks[i];
+        const float x = input_data_0[idxs[i] * 3];
+        const float y = input_data_0[idxs[i] * 3 + 1];
+        const float rx = cos_r * x - sin_r * y;
+        const float ry = sin_r * x + cos_r * y;
+        min_x = std::min(min_x, rx);
+        min_y = std::min(min_y, ry);
+        max_x = std::max(max_x, rx);
+        max_y = std::max(max_y, ry);
     }
-    float3 xy1_max = landmarks[0], xy1_min = landmarks[0];
-    for (int i = 1; i < landmarks.size(); i++)
-    {
-        if (xy1_max.x < landmarks[i].x) xy1_max.x = landmarks[i].x;
-        if (xy1_max.y < landmarks[i].y) xy1_max.y = landmarks[i].y;
 
-        if (xy1_min.x > landmarks[i].x) xy1_min.x = landmarks[i].x;
-        if (xy1_min.y > landmarks[i].y) xy1_min.y = landmarks[i].y;
-    }
-    *crop_width = xy1_max.x - xy1_min.x;
-    *crop_height = xy1_max.y - xy1_min.y;
-    float3 crop_xy1 = xy1_min;
-    crop_xy1.x += xy1_max.x;
-    crop_xy1.y += xy1_max.y;
-    crop_xy1.x /= 2;
-    crop_xy1.y /= 2;
-    crop_xy1 = t_rotation_inverse * crop_xy1;
+    *crop_width = (max_x - min_x) * 0.25f;
+    *crop_height = (max_y - min_y) * 0.25f;
+
+    const Mat3 t_rotation_inverse = Mat3(cos_r, sin_r, 0.0,
+                                         -sin_r, cos_r, 0.0,
+                                         0.0, 0.0, 1.0);
+    const float3 crop_xy1 = t_rotation_inverse * float3((min_x + max_x) * 0.125f, (min_y + max_y) * 0.125f, 1.0f);
     *crop_x = crop_xy1.x;
     *crop_y = crop_xy1.y;
 }
@@ -106,36 +143,23 @@ static void landmarksToTransformMatrix(const int left_rotation_idx,const int& ri
     float crop_x = 0.0, crop_y = 0.0, crop_width = 0.0, crop_height = 0.0;
     estimateCenterAndSize(landmarks, subset_idxs, rotation_radians,&crop_x, &crop_y, &crop_width, &crop_height);
 
-    Mat4 t = Mat4(1.0, 0.0, 0.0, 0.0,
-                  0.0, 1.0, 0.0, 0.0,
-                  0.0, 0.0, 1.0, 0.0,
-                  0.0, 0.0, 0.0, 1.0);
-    const Mat4 t_shift = Mat4(1.0, 0.0, 0.0, crop_x,
-                              0.0, 1.0, 0.0, crop_y,
-                              0.0, 0.0, 1.0, 0.0,
-                              0.0, 0.0, 0.0, 1.0);
-    t *= t_shift;
-    const float& r = -rotation_radians;
-    const Mat4 t_rotation = Mat4(std::cos(r), -std::sin(r), 0.0, 0.0,
-                                 std::sin(r), std::cos(r), 0.0, 0.0,
-                                 0.0, 0.0, 1.0, 0.0,
-                                 0.0, 0.0, 0.0, 1.0);
-    t *= t_rotation;
+    // shift(crop) * rotate(-r) * scale * shift(-output / 2) composed in closed form
+    const float cos_r = std::cos(-rotation_radians);
+    const float sin_r = std::sin(-rotation_radians);
     const float scale_x = scale_x_ * crop_width / output_width;
     const float scale_y = scale_y_ * crop_height / output_height;
-    const Mat4 t_scale = Mat4(scale_x, 0.0, 0.0, 0.0,
-                              0.0, scale_y, 0.0, 0.0,
-                              0.0, 0.0, 1.0, 0.0,
-                              0.0, 0.0, 0.0, 1.0);
-    t *= t_scale;
-    const float shift_x = -1.0 * (output_width / 2.0);
-    const float shift_y = -1.0 * (output_height / 2.0);
-    const Mat4 t_shift2 = Mat4(1.0, 0.0, 0.0, shift_x,
-                               0.0, 1.0, 0.0, shift_y,
-                               0.0, 0.0, 1.0, 0.0,
-                               0.0, 0.0, 0.0, 1.0);
-    t *= t_shift2;
-    std::memcpy(output_data, t.data.data(), 16 * sizeof(float));
+    const float shift_x = -0.5f * output_width;
+    const float shift_y = -0.5f * output_height;
+
+    const float a = cos_r * scale_x;
+    const float b = -sin_r * scale_y;
+    const float c = sin_r * scale_x;
+    const float d = cos_r * scale_y;
+    const Mat4 t = Mat4(a, b, 0.0, a * shift_x + b * shift_y + crop_x,
+                        c, d, 0.0, c * shift_x + d * shift_y + crop_y,
+                        0.0, 0.0, 1.0, 0.0,
+                        0.0, 0.0, 0.0, 1.0);
+    memcpy(output_data, t.data.data(), 16 * sizeof(float));
 }
 
 float dotProduct(const float4& l, const float4& r)
@@ -209,22 +233,64 @@ static void transformTensorBilinear(const std::vector<int>& input0_shape, const
     }
 }
 
-static void refine_part(const ncnn::Net& net, TransformParam& transform_param, const ncnn::Mat& face_mesh,const std::vector<int>& eye_idxs,
-                 const ncnn::Mat& features,const float* trans_matrix_scale, ncnn::Mat& refine_eye, ncnn::Mat& refine_iris)
+static void transform_points(const float* pts, int stride, int count, const float* m, cv::Point2f* out)
 {
+    float* outptr = (float*)out;
+
+    int i = 0;
+#if __ARM_NEON
+    const float32x4_t _m0 = vdupq_n_f32(m[0]);
+    const float32x4_t _m1 = vdupq_n_f32(m[1]);
+    const float32x4_t _m2 = vdupq_n_f32(m[2]);
+    const float32x4_t _m3 = vdupq_n_f32(m[3]);
+    const float32x4_t _m4 = vdupq_n_f32(m[4]);
+    const float32x4_t _m5 = vdupq_n_f32(m[5]);
+    for (; i + 3 < count; i += 4)
+    {
+        float32x4_t _x;
+        float32x4_t _y;
+        if (stride == 3)
+        {
+            float32x4x3_t _p = vld3q_f32(pts + i * 3);
+            _x = _p.val[0];
+            _y = _p.val[1];
+        }
+        else
+        {
+            float32x4x2_t _p = vld2q_f32(pts + i * 2);
+            _x = _p.val[0];
+            _y = _p.val[1];
+        }
+        float32x4x2_t _out;
+        _out.val[0] = vmlaq_f32(vmlaq_f32(_m2, _m0, _x), _m1, _y);
+        _out.val[1] = vmlaq_f32(vmlaq_f32(_m5, _m3, _x), _m4, _y);
+        vst2q_f32(outptr + i * 2, _out);
+    }
+#endif // __ARM_NEON
+    for (; i < count; i++)
+    {
+        const float x = pts[i * stride];
+        const float y = pts[i * stride + 1];
+        outptr[i * 2] = x * m[0] + y * m[1] + m[2];
+        outptr[i * 2 + 1] = x * m[3] + y * m[4] + m[5];
+    }
+}
 
+static void refine_part(ncnn::Extractor& ex, const TransformParam& transform_param, const ncnn::Mat& face_mesh,const std::vector<int>& eye_idxs,
+                 const ncnn::Mat& features,const float* trans_matrix_scale, ncnn::Mat& refine_eye, ncnn::Mat& refine_iris)
+{
+    float output_trans_matrix[16];
     landmarksToTransformMatrix(transform_param.left_roration_idx, transform_param.right_rotation_idx, 0,
                                  eye_idxs, transform_param.scale_x, transform_param.scale_y, transform_param.output_width,
-                                 transform_param.output_height, (float*)face_mesh.data, transform_param.output_trans_matrix.data());
+                                 transform_param.output_height, (float*)face_mesh.data, output_trans_matrix);
 
     std::vector<int> input_shape{ 48,48,32 };
     std::vector<int> output_shape{ 16,16,32 };
 
     ncnn::Mat output_trans_bilinear = ncnn::Mat(32, 16, 16, sizeof(float));
-    transformTensorBilinear(input_shape, (float*)features.data, transform_param.output_trans_matrix.data(),
+    transformTensorBilinear(input_shape, (float*)features.data, output_trans_matrix,
             output_shape, (float*)output_trans_bilinear.data);
 
-    ncnn::Extractor ex = net.create_extractor();
     ex.input(transform_param.input.c_str(), output_trans_bilinear);
 
     if (transform_param.outputs.size()==1)
@@ -237,12 +303,12 @@ static void refine_part(const ncnn::Net& net, TransformParam& transform_param, c
         ex.extract(transform_param.outputs[1].c_str(), refine_iris);
     }
 
-    float q_11 = transform_param.output_trans_matrix[0] * trans_matrix_scale[0];
-    float q_12 = transform_param.output_trans_matrix[1] * trans_matrix_scale[1];
-    float q_13 = transform_param.output_trans_matrix[3] * trans_matrix_scale[3];
-    float q_21 = transform_param.output_trans_matrix[4] * trans_matrix_scale[4];
-    float q_22 = transform_param.output_trans_matrix[5] * trans_matrix_scale[5];
-    float q_23 = transform_param.output_trans_matrix[7] * trans_matrix_scale[7];
+    float q_11 = output_trans_matrix[0] * trans_matrix_scale[0];
+    float q_12 = output_trans_matrix[1] * trans_matrix_scale[1];
+    float q_13 = output_trans_matrix[3] * trans_matrix_scale[3];
+    float q_21 = output_trans_matrix[4] * trans_matrix_scale[4];
+    float q_22 = output_trans_matrix[5] * trans_matrix_scale[5];
+    float q_23 = output_trans_matrix[7] * trans_matrix_scale[7];
     int w = refine_eye.w;
     for (int i = 0; i < refine_eye.c; i++)
     {
@@ -277,26 +343,11 @@ static void refine_part(const ncnn::Net& net, TransformParam& transform_param, c
 
 int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu)
 {
-    landmark.clear();
-
-    ncnn::set_cpu_powersave(2);
-    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
-
-    landmark.opt = ncnn::Option();
-
-#if NCNN_VULKAN
-    landmark.opt.use_vulkan_compute = use_gpu;
-#endif
-
-    landmark.opt.num_threads = ncnn::get_big_cpu_count();
+    contexts.clear();
 
-    char parampath[256];
-    char modelpath[256];
-    sprintf(parampath, "%s.param", modeltype);
-    sprintf(modelpath, "%s.bin", modeltype);
-
-    landmark.load_param(mgr, parampath);
-    landmark.load_model(mgr, modelpath);
+    landmark = ModelRegistry::get(mgr, modeltype, use_gpu);
+    if (!landmark)
+        return -1;
 
     left_transform_param.left_roration_idx = 33;
     left_transform_param.output_height = 16;
@@ -304,7 +355,6 @@ int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu
     left_transform_param.right_rotation_idx = 133;
     left_transform_param.scale_x = 1.5;
     left_transform_param.scale_y = 1.5;
-    left_transform_param.output_trans_matrix.reserve(16);
     left_transform_param.input = "left/input";
     left_transform_param.outputs.emplace_back("left/eye");
     left_transform_param.outputs.emplace_back("left/iris");
@@ -315,7 +365,6 @@ int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu
     right_transform_param.right_rotation_idx = 263;
     right_transform_param.scale_x = 1.5;
     right_transform_param.scale_y = 1.5;
-    right_transform_param.output_trans_matrix.reserve(16);
     right_transform_param.input = "right/input";
     right_transform_param.outputs.emplace_back("right/eye");
     right_transform_param.outputs.emplace_back("right/iris");
@@ -326,76 +375,125 @@ int LandmarkDetect::load(AAssetManager* mgr, const char* modeltype, bool use_gpu
     lip_transform_param.right_rotation_idx = 291;
     lip_transform_param.scale_x = 1.5;
     lip_transform_param.scale_y = 1.5;
-    lip_transform_param.output_trans_matrix.reserve(16);
     lip_transform_param.input = "lips/input";
     lip_transform_param.outputs.emplace_back("lips/output");
     return 0;
 }
 
 int LandmarkDetect::detect(const cv::Mat& rgb,const cv::Mat& trans_mat, std::vector<cv::Point2f> &landmarks,
-        std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes)
+        std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads) const
 {
-    cv::Mat input = rgb.clone();
+    return detect(rgb, trans_mat, trans_mat, landmarks, left_eyes, right_eyes, num_threads);
+}
 
-    const float mean_vals[3] = { 127.5f, 127.5f,  127.5f };
-    const float norm_vals[3] = { 1/127.5f, 1 / 127.5f, 1 / 127.5f };
-    ncnn::Mat in = ncnn::Mat::from_pixels(input.data, ncnn::Mat::PIXEL_RGB, input.cols, input.rows);
-    in.substract_mean_normalize(mean_vals, norm_vals);
-    ncnn::Extractor ex = landmark.create_extractor();
+// crop to frame affine, fetched once as float
+static void affine_to_float(const cv::Mat& trans_mat, float* m)
+{
+    m[0] = (float)trans_mat.at<double>(0, 0);
+    m[1] = (float)trans_mat.at<double>(0, 1);
+    m[2] = (float)trans_mat.at<double>(0, 2);
+    m[3] = (float)trans_mat.at<double>(1, 0);
+    m[4] = (float)trans_mat.at<double>(1, 1);
+    m[5] = (float)trans_mat.at<double>(1, 2);
+}
+
+static const float landmark_mean_vals[3] = { 127.5f, 127.5f,  127.5f };
+static const float landmark_norm_vals[3] = { 1/127.5f, 1 / 127.5f, 1 / 127.5f };
+
+int LandmarkDetect::detect(const cv::Mat& rgb, const cv::Mat& sample_mat, const cv::Mat& trans_mat, std::vector<cv::Point2f> &landmarks,
+        std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads) const
+{
+    float sm[6];
+    float m[6];
+    affine_to_float(sample_mat, sm);
+    affine_to_float(trans_mat, m);
+
+    ncnn::Mat in;
+    warp_affine_normalize(rgb, sm, 192, 192, landmark_mean_vals, landmark_norm_vals, in);
+
+    return detect(in, m, landmarks, left_eyes, right_eyes, num_threads);
+}
+
+int LandmarkDetect::detect(const unsigned char* nv21, int nv21_width, int nv21_height, const cv::Mat& sample_mat, const cv::Mat& trans_mat, std::vector<cv::Point2f> &landmarks,
+        std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads) const
+{
+    float sm[6];
+    float m[6];
+    affine_to_float(sample_mat, sm);
+    affine_to_float(trans_mat, m);
+
+    ncnn::Mat in;
+    warp_affine_normalize_nv21(nv21, nv21_width, nv21_height, sm, 192, 192, landmark_mean_vals, landmark_norm_vals, in);
+
+    return detect(in, m, landmarks, left_eyes, right_eyes, num_threads);
+}
+
+int LandmarkDetect::detect(const ncnn::Mat& in, const float* m, std::vector<cv::Point2f> &landmarks,
+        std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads) const
+{
+    InferenceContextGuard ctx(contexts);
+
+    // the refine heads have their own inputs, so one extractor serves the whole face
+    ncnn::Extractor ex = landmark->net.create_extractor();
+    ex.set_blob_allocator(&ctx->blob_pool_allocator);
+    ex.set_workspace_allocator(&ctx->workspace_pool_allocator);
+    if (num_threads > 0)
+    {
+        // worker of a team the caller bound with the landmark policy, only size the extractor
+        ex.set_num_threads(num_threads);
+    }
+    else
+    {
+        policy.apply(ex);
+    }
     ex.input("net/input", in);
 
     ncnn::Mat face_mesh, features;
     ex.extract("net/output", face_mesh);
     ex.extract("net/features", features);
 
-    std::vector<cv::Point2f> pts;
     ncnn::Mat data = face_mesh.channel(0);
-    float* points_data = (float*)data.data;
-
-    for (int i = 0; i < 468; i++)
-    {
-        cv::Point2f pt;
-        float x = points_data[i * 3];
-        float y = points_data[i * 3 + 1];
-        pt.x = x * trans_mat.at<double>(0, 0) + y * trans_mat.at<double>(0, 1) + trans_mat.at<double>(0, 2);
-        pt.y = x * trans_mat.at<double>(1, 0) + y * trans_mat.at<double>(1, 1) + trans_mat.at<double>(1, 2);
-        landmarks.push_back(pt);
-    }
+    landmarks.resize(468);
+    transform_points((const float*)data.data, 3, 468, m, landmarks.data());
 
     ncnn::Mat left_eye, left_iris;
-    refine_part(landmark, left_transform_param, face_mesh,left_eye_idxs, features, trans_matrix_scale, left_eye, left_iris);
+    refine_part(ex, left_transform_param, face_mesh,left_eye_idxs, features, trans_matrix_scale, left_eye, left_iris);
 
     ncnn::Mat right_eye, right_iris;
-    refine_part(landmark, right_transform_param, face_mesh,right_eye_idxs, features, trans_matrix_scale, right_eye, right_iris);
+    refine_part(ex, right_transform_param, face_mesh,right_eye_idxs, features, trans_matrix_scale, right_eye, right_iris);
 
     ncnn::Mat lips,tmp;
-    refine_part(landmark, lip_transform_param, face_mesh, lips_idxs, features, trans_matrix_scale, lips, tmp);
+    refine_part(ex, lip_transform_param, face_mesh, lips_idxs, features, trans_matrix_scale, lips, tmp);
 
-    for(int i = 0;  i < 71; i++)
-    {
-        cv::Point2f left_pt;
-        float x = left_eye[i * 2];
-        float y = left_eye[i * 2 + 1];
-        left_pt.x = x * trans_mat.at<double>(0, 0) + y * trans_mat.at<double>(0, 1) + trans_mat.at<double>(0, 2);
-        left_pt.y = x * trans_mat.at<double>(1, 0) + y * trans_mat.at<double>(1, 1) + trans_mat.at<double>(1, 2);
-        left_eyes.push_back(left_pt);
-
-        cv::Point2f right_pt;
-        x = right_eye[i * 2];
-        y = right_eye[i * 2 + 1];
-        right_pt.x = x * trans_mat.at<double>(0, 0) + y * trans_mat.at<double>(0, 1) + trans_mat.at<double>(0, 2);
-        right_pt.y = x * trans_mat.at<double>(1, 0) + y * trans_mat.at<double>(1, 1) + trans_mat.at<double>(1, 2);
-        right_eyes.push_back(right_pt);
-    }
-    for (int i = 0; i < lips_idxs.size(); i++)
+    left_eyes.resize(71);
+    transform_points((const float*)left_eye.data, 2, 71, m, left_eyes.data());
+
+    right_eyes.resize(71);
+    transform_points((const float*)right_eye.data, 2, 71, m, right_eyes.data());
+
+    // lips overwrite the mesh points they refine, unproject in place then scatter
+    const int lips_count = lips_idxs.size();
+    cv::Point2f* lip_pts = (cv::Point2f*)lips.data;
+    transform_points((const float*)lips.data, 2, lips_count, m, lip_pts);
+    for (int i = 0; i < lips_count; i++)
     {
-        cv::Point2f lip_pt;
-        float x = lips[i * 2];
-        float y = lips[i * 2 + 1];
-        lip_pt.x = x * trans_mat.at<double>(0, 0) + y * trans_mat.at<double>(0, 1) + trans_mat.at<double>(0, 2);
-        lip_pt.y = x * trans_mat.at<double>(1, 0) + y * trans_mat.at<double>(1, 1) + trans_mat.at<double>(1, 2);
-        landmarks[lips_idxs[i]] = lip_pt;
+        landmarks[lips_idxs[i]] = lip_pts[i];
     }
     return 0;
 }
 
+int LandmarkDetect::warmup() const
+{
+    cv::Mat rgb(192, 192, CV_8UC3, cv::Scalar(127, 127, 127));
+    cv::Mat trans_mat = cv::Mat::eye(2, 3, CV_64F);
+
+    std::vector<cv::Point2f> landmarks;
+    std::vector<cv::Point2f> left_eyes;
+    std::vector<cv::Point2f> right_eyes;
+    return detect(rgb, trans_mat, landmarks, left_eyes, right_eyes);
+}
+
+void LandmarkDetect::set_policy(const StagePolicy& _policy)
+{
+    policy = _policy;
+}
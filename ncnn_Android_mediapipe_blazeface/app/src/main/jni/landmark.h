@@ -15,9 +15,13 @@
 #ifndef LANDMARK_H
 #define LANDMARK_H
 
+#include <array>
 #include <opencv2/core/core.hpp>
 #include <net.h>
 
+#include "modelregistry.h"
+#include "stagepolicy.h"
+
 struct TransformParam
 {
     int left_roration_idx;
@@ -26,7 +30,6 @@ struct TransformParam
     int right_rotation_idx;
     float scale_x;
     float scale_y;
-    std::vector<float> output_trans_matrix;
     std::string input;
     std::vector<std::string> outputs;
 };
@@ -46,12 +49,12 @@ using float2 =  cv::Point2f;
 using float3 = cv::Point3f;
 using int3 = cv::Point3i;
 struct Mat3 {
-    Mat3() { data.resize(9); }
-    Mat3(float x00, float x01, float x02, float x10, float x11, float x12,
+    constexpr Mat3() : data{} {}
+    constexpr Mat3(float x00, float x01, float x02, float x10, float x11, float x12,
          float x20, float x21, float x22)
-            : data{ x00, x01, x02, x10, x11, x12, x20, x21, x22 } {}
+            : data{ { x00, x01, x02, x10, x11, x12, x20, x21, x22 } } {}
 
-    Mat3 operator*(const Mat3& other) {
+    Mat3 operator*(const Mat3& other) const {
         Mat3 result;
         for (int r = 0; r < 3; r++) {
             for (int c = 0; c < 3; c++) {
@@ -72,19 +75,19 @@ struct Mat3 {
 
         return result;
     }
-    float Get(int x, int y) const { return data[x * 3 + y]; }
+    constexpr float Get(int x, int y) const { return data[x * 3 + y]; }
     void Set(int x, int y, float val) { data[x * 3 + y] = val; }
 
-    std::vector<float> data;
+    std::array<float, 9> data;
 };
 
 struct Mat4 {
-    Mat4() { data.resize(16); }
-    Mat4(float x00, float x01, float x02, float x03, float x10, float x11,
+    constexpr Mat4() : data{} {}
+    constexpr Mat4(float x00, float x01, float x02, float x03, float x10, float x11,
          float x12, float x13, float x20, float x21, float x22, float x23,
          float x30, float x31, float x32, float x33)
-            : data{ x00, x01, x02, x03, x10, x11, x12, x13,
-                    x20, x21, x22, x23, x30, x31, x32, x33 } {}
+            : data{ { x00, x01, x02, x03, x10, x11, x12, x13,
+                    x20, x21, x22, x23, x30, x31, x32, x33 } } {}
     void operator*=(const Mat4& other) {
         Mat4 result;
         for (int r = 0; r < 4; r++) {
@@ -96,26 +99,45 @@ struct Mat4 {
                 result.Set(r, c, sum);
             }
         }
-        std::memcpy(this->data.data(), result.data.data(),
-                    result.data.size() * sizeof(float));
+        data = result.data;
     }
-    float Get(int x, int y) const { return data[x * 4 + y]; }
+    constexpr float Get(int x, int y) const { return data[x * 4 + y]; }
     void Set(int x, int y, float val) { data[x * 4 + y] = val; }
 
-    std::vector<float> data;
+    std::array<float, 16> data;
 };
 class LandmarkDetect
 {
 public:
     int load(AAssetManager* mgr, const char* modeltype, bool use_gpu = false);
+    // num_threads 0 follows the stage policy
     int detect(const cv::Mat& rgb, const cv::Mat& trans_mat, std::vector<cv::Point2f> &landmarks,
-               std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes);
+               std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads = 0) const;
+    // sample_mat maps crop pixels into rgb, trans_mat maps them into the frame the points are reported in
+    int detect(const cv::Mat& rgb, const cv::Mat& sample_mat, const cv::Mat& trans_mat, std::vector<cv::Point2f> &landmarks,
+               std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads = 0) const;
+
+    // same with the crop sampled straight from a nv21 frame
+    int detect(const unsigned char* nv21, int nv21_width, int nv21_height, const cv::Mat& sample_mat, const cv::Mat& trans_mat, std::vector<cv::Point2f> &landmarks,
+               std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads = 0) const;
+
+    // run one dummy face through the mesh and all refine heads
+    int warmup() const;
+
+    void set_policy(const StagePolicy& policy);
+    const StagePolicy& stage_policy() const { return policy; }
 
 private:
+    // mesh and refine heads on a prepared 192x192 input, m maps crop pixels into the reported frame
+    int detect(const ncnn::Mat& in, const float* m, std::vector<cv::Point2f> &landmarks,
+               std::vector<cv::Point2f>& left_eyes,std::vector<cv::Point2f>& right_eyes, int num_threads) const;
+
     TransformParam left_transform_param;
     TransformParam right_transform_param;
     TransformParam lip_transform_param;
-    ncnn::Net landmark;
+    std::shared_ptr<const SharedNet> landmark;
+    StagePolicy policy;
+    mutable InferenceContextPool contexts;
 };
 
 #endif // LANDMARK_H
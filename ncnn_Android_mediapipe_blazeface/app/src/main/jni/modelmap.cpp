@@ -0,0 +1,201 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "modelmap.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <android/log.h>
+
+#include <datareader.h>
+
+ModelMap::ModelMap()
+{
+    map_base = 0;
+    map_size = 0;
+    ptr = 0;
+    len = 0;
+}
+
+ModelMap::~ModelMap()
+{
+    close();
+}
+
+int ModelMap::open(AAssetManager* mgr, const char* assetpath)
+{
+    close();
+
+    AAsset* asset = AAssetManager_open(mgr, assetpath, AASSET_MODE_UNKNOWN);
+    if (!asset)
+        return -1;
+
+    // only uncompressed assets expose a descriptor into the apk
+    off_t start = 0;
+    off_t length = 0;
+    int fd = AAsset_openFileDescriptor(asset, &start, &length);
+    AAsset_close(asset);
+
+    if (fd < 0)
+        return -1;
+
+    int ret = map(fd, (long)start, (size_t)length);
+    ::close(fd);
+
+    return ret;
+}
+
+int ModelMap::open(const char* filepath)
+{
+    close();
+
+    int fd = ::open(filepath, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    int ret = map(fd, 0, (size_t)st.st_size);
+    ::close(fd);
+
+    return ret;
+}
+
+int ModelMap::map(int fd, long offset, size_t length)
+{
+    if (length == 0)
+        return -1;
+
+    // mmap offset must be page aligned, the asset may start anywhere inside the apk
+    const long page_size = sysconf(_SC_PAGESIZE);
+    const long aligned_offset = offset / page_size * page_size;
+    const size_t delta = offset - aligned_offset;
+
+    void* base = mmap(0, length + delta, PROT_READ, MAP_SHARED, fd, aligned_offset);
+    if (base == MAP_FAILED)
+        return -1;
+
+    const unsigned char* p = (const unsigned char*)base + delta;
+
+    // ncnn references weights in place only from 4-byte aligned memory
+    if ((uintptr_t)p % 4 != 0)
+    {
+        munmap(base, length + delta);
+        return -1;
+    }
+
+    map_base = base;
+    map_size = length + delta;
+    ptr = p;
+    len = length;
+
+    return 0;
+}
+
+void ModelMap::close()
+{
+    if (map_base)
+    {
+        munmap(map_base, map_size);
+    }
+
+    map_base = 0;
+    map_size = 0;
+    ptr = 0;
+    len = 0;
+}
+
+// DataReaderFromMemory with a bound, a short or mismatched .bin fails instead of reading past the mapping
+class DataReaderFromMapping : public ncnn::DataReader
+{
+public:
+    DataReaderFromMapping(const unsigned char* _mem, size_t _size) : mem(_mem), remain(_size) {}
+
+    virtual size_t read(void* buf, size_t size) const
+    {
+        if (size > remain)
+            return 0;
+
+        memcpy(buf, mem, size);
+        mem += size;
+        remain -= size;
+        return size;
+    }
+
+    // layers keep a pointer into the mapping instead of a copy
+    virtual size_t reference(size_t size, const void** buf) const
+    {
+        if (size > remain)
+            return 0;
+
+        *buf = mem;
+        mem += size;
+        remain -= size;
+        return size;
+    }
+
+    size_t remaining() const { return remain; }
+
+private:
+    mutable const unsigned char* mem;
+    mutable size_t remain;
+};
+
+static int load_model_heap(ncnn::Net& net, AAssetManager* mgr, const char* modelpath)
+{
+#if __ANDROID_API__ >= 9
+    return net.load_model(mgr, modelpath);
+#else
+    // host builds read models from the working directory
+    return net.load_model(modelpath);
+#endif
+}
+
+int load_model_mapped(ncnn::Net& net, ModelMap& weights, AAssetManager* mgr, const char* modelpath)
+{
+#if __ANDROID_API__ >= 9
+    int mapped = weights.open(mgr, modelpath);
+#else
+    int mapped = weights.open(modelpath);
+#endif
+
+    if (mapped == 0)
+    {
+        // layers reference the mapped weights instead of copying them
+        DataReaderFromMapping dr(weights.data(), weights.size());
+        if (net.load_model(dr) == 0 && dr.remaining() == 0)
+            return 0;
+
+        __android_log_print(ANDROID_LOG_WARN, "ncnn", "%s mapped but does not match the param, loading into heap", modelpath);
+
+        // reload every layer from the heap before the mapping goes away
+        int ret = load_model_heap(net, mgr, modelpath);
+        weights.close();
+        return ret;
+    }
+
+    __android_log_print(ANDROID_LOG_WARN, "ncnn", "%s is not mappable, loading into heap", modelpath);
+
+    return load_model_heap(net, mgr, modelpath);
+}
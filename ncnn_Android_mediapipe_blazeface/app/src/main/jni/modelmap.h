@@ -0,0 +1,57 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef MODELMAP_H
+#define MODELMAP_H
+
+#include <stddef.h>
+
+#include <android/asset_manager.h>
+
+#include <net.h>
+
+// read-only mapping of model weights, pages are loaded lazily and shared between processes
+class ModelMap
+{
+public:
+    ModelMap();
+    ~ModelMap();
+
+    // map an asset stored uncompressed in the apk, fails for compressed assets
+    int open(AAssetManager* mgr, const char* assetpath);
+
+    // map a plain file
+    int open(const char* filepath);
+
+    void close();
+
+    const unsigned char* data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+    int map(int fd, long offset, size_t length);
+
+    ModelMap(const ModelMap&);
+    ModelMap& operator=(const ModelMap&);
+
+    void* map_base;
+    size_t map_size;
+    const unsigned char* ptr;
+    size_t len;
+};
+
+// load weights zero-copy from a mapping of modelpath, falling back to a heap copy
+int load_model_mapped(ncnn::Net& net, ModelMap& weights, AAssetManager* mgr, const char* modelpath);
+
+#endif // MODELMAP_H
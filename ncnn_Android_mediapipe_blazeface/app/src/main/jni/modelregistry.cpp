@@ -0,0 +1,120 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "modelregistry.h"
+
+#include <stdio.h>
+
+#include <android/log.h>
+
+#include <map>
+#include <string>
+
+#include "cpu.h"
+
+static ncnn::Mutex registry_lock;
+static std::map<std::string, std::weak_ptr<const SharedNet> > registry_nets;
+
+std::shared_ptr<const SharedNet> ModelRegistry::get(AAssetManager* mgr, const char* modeltype, bool use_gpu)
+{
+    std::string key = std::string(modeltype) + (use_gpu ? "@gpu" : "@cpu");
+
+    {
+        ncnn::MutexLockGuard g(registry_lock);
+
+        std::shared_ptr<const SharedNet> cached = registry_nets[key].lock();
+        if (cached)
+            return cached;
+    }
+
+    // load without the lock, a slow asset read must not stall lookups of other models
+    std::shared_ptr<SharedNet> shared = std::make_shared<SharedNet>();
+
+    shared->net.opt = ncnn::Option();
+
+#if NCNN_VULKAN
+    shared->net.opt.use_vulkan_compute = use_gpu;
+#endif
+
+    shared->net.opt.num_threads = ncnn::get_big_cpu_count();
+
+    char parampath[256];
+    char modelpath[256];
+    sprintf(parampath, "%s.param", modeltype);
+    sprintf(modelpath, "%s.bin", modeltype);
+
+#if __ANDROID_API__ >= 9
+    int ret = shared->net.load_param(mgr, parampath);
+#else
+    // host builds read models from the working directory
+    int ret = shared->net.load_param(parampath);
+#endif
+    if (ret == 0)
+        ret = load_model_mapped(shared->net, shared->weights, mgr, modelpath);
+
+    if (ret != 0)
+    {
+        __android_log_print(ANDROID_LOG_ERROR, "ncnn", "load %s failed", modeltype);
+
+        // never cached, the next caller tries again
+        return std::shared_ptr<const SharedNet>();
+    }
+
+    ncnn::MutexLockGuard g(registry_lock);
+
+    // another caller loaded the same model meanwhile, keep one copy
+    std::shared_ptr<const SharedNet> cached = registry_nets[key].lock();
+    if (cached)
+        return cached;
+
+    registry_nets[key] = shared;
+
+    return shared;
+}
+
+InferenceContext::InferenceContext()
+{
+    blob_pool_allocator.set_size_compare_ratio(0.f);
+    workspace_pool_allocator.set_size_compare_ratio(0.f);
+}
+
+std::unique_ptr<InferenceContext> InferenceContextPool::acquire()
+{
+    {
+        ncnn::MutexLockGuard g(lock);
+
+        if (!contexts.empty())
+        {
+            std::unique_ptr<InferenceContext> ctx = std::move(contexts.back());
+            contexts.pop_back();
+            return ctx;
+        }
+    }
+
+    return std::unique_ptr<InferenceContext>(new InferenceContext);
+}
+
+void InferenceContextPool::release(std::unique_ptr<InferenceContext> ctx)
+{
+    ncnn::MutexLockGuard g(lock);
+
+    contexts.push_back(std::move(ctx));
+}
+
+void InferenceContextPool::clear()
+{
+    ncnn::MutexLockGuard g(lock);
+
+    contexts.clear();
+}
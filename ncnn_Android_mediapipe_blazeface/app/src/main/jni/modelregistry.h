@@ -0,0 +1,91 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+
+#include <memory>
+#include <vector>
+
+#include <android/asset_manager.h>
+
+#include <net.h>
+
+#include "facedetector.h"
+#include "modelmap.h"
+
+// a loaded net together with the weights it references, never modified once published
+struct SharedNet
+{
+    // declared before the net so the mapping outlives the layers referencing it
+    ModelMap weights;
+    ncnn::Net net;
+};
+
+// process wide cache of loaded nets, so memory grows with models rather than with streams
+//
+// nets carry no allocators, every user creates extractors with its own
+// blob and workspace allocators, which makes concurrent inference safe
+class ModelRegistry
+{
+public:
+    // returns the net for modeltype.param / modeltype.bin, loading it on first use
+    // empty when either file fails to load
+    static std::shared_ptr<const SharedNet> get(AAssetManager* mgr, const char* modeltype, bool use_gpu = false);
+};
+
+// blob and workspace pools serving one inference at a time
+struct InferenceContext
+{
+    InferenceContext();
+
+    ncnn::UnlockedPoolAllocator blob_pool_allocator;
+    ncnn::PoolAllocator workspace_pool_allocator;
+
+    // decode and nms vectors, only touched by detector inference
+    DetectorScratch detector_scratch;
+};
+
+// hands each concurrent caller its own context, contexts are recycled so their pools stay warm
+class InferenceContextPool
+{
+public:
+    std::unique_ptr<InferenceContext> acquire();
+    void release(std::unique_ptr<InferenceContext> ctx);
+
+    void clear();
+
+private:
+    ncnn::Mutex lock;
+    std::vector<std::unique_ptr<InferenceContext> > contexts;
+};
+
+// borrows a context for the enclosing scope, declare it before any Mat allocated from it
+class InferenceContextGuard
+{
+public:
+    explicit InferenceContextGuard(InferenceContextPool& _pool) : pool(_pool), ctx(_pool.acquire()) {}
+    ~InferenceContextGuard() { pool.release(std::move(ctx)); }
+
+    InferenceContext* operator->() const { return ctx.get(); }
+
+private:
+    InferenceContextGuard(const InferenceContextGuard&);
+    InferenceContextGuard& operator=(const InferenceContextGuard&);
+
+    InferenceContextPool& pool;
+    std::unique_ptr<InferenceContext> ctx;
+};
+
+#endif // MODELREGISTRY_H
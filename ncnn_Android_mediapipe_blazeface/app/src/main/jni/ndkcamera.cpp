@@ -14,6 +14,11 @@
 
 #include "ndkcamera.h"
 
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
 #include <string>
 
 #include <android/log.h>
@@ -79,15 +84,24 @@ static void onImageAvailable(void* context, AImageReader* reader)
     AImage_getPlaneData(image, 1, &u_data, &u_len);
     AImage_getPlaneData(image, 2, &v_data, &v_len);
 
+    // only copy into a free slot here, inference runs on the consumer thread
+    FrameRing& frame_ring = ((NdkCamera*)context)->frame_ring;
+
+    unsigned char* nv21 = frame_ring.begin_write(width, height);
+    if (!nv21)
+    {
+        AImage_delete(image);
+        return;
+    }
+
     if (u_data == v_data + 1 && v_data == y_data + width * height && y_pixelStride == 1 && u_pixelStride == 2 && v_pixelStride == 2 && y_rowStride == width && u_rowStride == width && v_rowStride == width)
     {
         // already nv21  :)
-        ((NdkCamera*)context)->on_image((unsigned char*)y_data, (int)width, (int)height);
+        memcpy(nv21, y_data, width * height + width * height / 2);
     }
     else
     {
         // construct nv21
-        unsigned char* nv21 = new unsigned char[width * height + width * height / 2];
         {
             // Y
             unsigned char* yptr = nv21;
@@ -118,13 +132,11 @@ static void onImageAvailable(void* context, AImageReader* reader)
                 }
             }
         }
-
-        ((NdkCamera*)context)->on_image((unsigned char*)nv21, (int)width, (int)height);
-
-        delete[] nv21;
     }
 
     AImage_delete(image);
+
+    frame_ring.end_write();
 }
 
 static void onSessionActive(void* context, ACameraCaptureSession *session)
@@ -162,6 +174,156 @@ void onCaptureCompleted(void* context, ACameraCaptureSession* session, ACaptureR
 //     __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "onCaptureCompleted %p %p %p", session, request, result);
 }
 
+FrameRing::FrameRing()
+{
+    head = 0;
+    tail = 0;
+    reading = 0;
+    received_count = 0;
+    dropped_count = 0;
+
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        slots[i].width = 0;
+        slots[i].height = 0;
+    }
+
+    sem_init(&available, 0, 0);
+}
+
+FrameRing::~FrameRing()
+{
+    sem_destroy(&available);
+}
+
+void FrameRing::reset(int width, int height)
+{
+    for (int i = 0; i < SLOT_COUNT; i++)
+    {
+        slots[i].nv21.resize(width * height + width * height / 2);
+        slots[i].width = width;
+        slots[i].height = height;
+    }
+
+    head = 0;
+    tail = 0;
+    reading = 0;
+    received_count = 0;
+    dropped_count = 0;
+
+    while (sem_trywait(&available) == 0)
+    {
+    }
+}
+
+unsigned char* FrameRing::begin_write(int width, int height)
+{
+    received_count++;
+
+    const unsigned int h = head.load(std::memory_order_relaxed);
+    const unsigned int t = tail.load(std::memory_order_acquire);
+    if (h - t >= SLOT_COUNT)
+    {
+        dropped_count++;
+        return 0;
+    }
+
+    // the slot is owned by the producer until end_write, resizing only happens on geometry change
+    Slot& slot = slots[h % SLOT_COUNT];
+    slot.nv21.resize(width * height + width * height / 2);
+    slot.width = width;
+    slot.height = height;
+
+    return slot.nv21.data();
+}
+
+void FrameRing::end_write()
+{
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    sem_post(&available);
+}
+
+const unsigned char* FrameRing::begin_read(int* width, int* height)
+{
+    while (sem_wait(&available) != 0)
+    {
+    }
+
+    const unsigned int h = head.load(std::memory_order_acquire);
+    const unsigned int t = tail.load(std::memory_order_relaxed);
+    if (h == t)
+        return 0;
+
+    if (h - t > 1)
+    {
+        // skip to the newest frame and hand the stale slots back right away
+        dropped_count += h - 1 - t;
+        tail.store(h - 1, std::memory_order_release);
+    }
+
+    reading = h - 1;
+
+    const Slot& slot = slots[reading % SLOT_COUNT];
+    *width = slot.width;
+    *height = slot.height;
+
+    return slot.nv21.data();
+}
+
+void FrameRing::end_read()
+{
+    tail.store(reading + 1, std::memory_order_release);
+}
+
+void FrameRing::wake()
+{
+    sem_post(&available);
+}
+
+bool FrameBufferPool::Key::operator<(const Key& k) const
+{
+    if (tag != k.tag)
+        return tag < k.tag;
+    if (rows != k.rows)
+        return rows < k.rows;
+    if (cols != k.cols)
+        return cols < k.cols;
+    return type < k.type;
+}
+
+cv::Mat& FrameBufferPool::get(int tag, int rows, int cols, int type)
+{
+    Key key = {tag, rows, cols, type};
+
+    std::map<Key, cv::Mat>::iterator it = buffers.find(key);
+    if (it != buffers.end())
+        return it->second;
+
+    // a handful of geometries per tag at most, forget the stale ones of this tag if resizing keeps going
+    // buffers of other tags may still be referenced by the current frame
+    if (buffers.size() > 16)
+    {
+        for (it = buffers.begin(); it != buffers.end();)
+        {
+            if (it->first.tag == tag)
+                buffers.erase(it++);
+            else
+                ++it;
+        }
+    }
+
+    cv::Mat& m = buffers[key];
+    m.create(rows, cols, type);
+
+    return m;
+}
+
+void FrameBufferPool::clear()
+{
+    buffers.clear();
+}
+
 NdkCamera::NdkCamera()
 {
     camera_facing = 0;
@@ -177,38 +339,96 @@ NdkCamera::NdkCamera()
     capture_session_output = 0;
     capture_session = 0;
 
+    consumer_stop = false;
 
-    // setup imagereader and its surface
+    capture_width = 0;
+    capture_height = 0;
+
+    request_width = 640;
+    request_height = 480;
+    request_max_images = 2;
+    request_min_fps = 0;
+    request_max_fps = 0;
+}
+
+NdkCamera::~NdkCamera()
+{
+    close();
+}
+
+void NdkCamera::set_capture_config(int width, int height, int max_images, int min_fps, int max_fps)
+{
+    request_width = width;
+    request_height = height;
+    request_max_images = std::max(max_images, 1);
+    request_min_fps = min_fps;
+    request_max_fps = max_fps;
+}
+
+static void choose_stream_size(const ACameraMetadata* camera_metadata, int request_width, int request_height, int* width, int* height)
+{
+    *width = request_width;
+    *height = request_height;
+
+    ACameraMetadata_const_entry e = { 0 };
+    if (ACameraMetadata_getConstEntry(camera_metadata, ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS, &e) != ACAMERA_OK)
+        return;
+
+    // prefer the requested aspect ratio, then the closest pixel count
+    const int request_area = request_width * request_height;
+    bool best_same_aspect = false;
+    int best_area_diff = INT_MAX;
+    for (uint32_t i = 0; i + 3 < e.count; i += 4)
     {
-        AImageReader_new(640, 480, AIMAGE_FORMAT_YUV_420_888, /*maxImages*/2, &image_reader);
+        const int32_t format = e.data.i32[i];
+        const int32_t w = e.data.i32[i + 1];
+        const int32_t h = e.data.i32[i + 2];
+        const int32_t is_input = e.data.i32[i + 3];
 
-        AImageReader_ImageListener listener;
-        listener.context = this;
-        listener.onImageAvailable = onImageAvailable;
+        if (format != AIMAGE_FORMAT_YUV_420_888 || is_input != ACAMERA_SCALER_AVAILABLE_STREAM_CONFIGURATIONS_OUTPUT)
+            continue;
 
-        AImageReader_setImageListener(image_reader, &listener);
+        const bool same_aspect = w * request_height == h * request_width;
+        const int area_diff = abs(w * h - request_area);
 
-        AImageReader_getWindow(image_reader, &image_reader_surface);
+        if (best_same_aspect && !same_aspect)
+            continue;
 
-        ANativeWindow_acquire(image_reader_surface);
+        if (same_aspect == best_same_aspect && area_diff >= best_area_diff)
+            continue;
+
+        best_same_aspect = same_aspect;
+        best_area_diff = area_diff;
+        *width = w;
+        *height = h;
     }
 }
 
-NdkCamera::~NdkCamera()
+static bool choose_fps_range(const ACameraMetadata* camera_metadata, int request_min_fps, int request_max_fps, int32_t* fps_range)
 {
-    close();
+    if (request_min_fps <= 0 && request_max_fps <= 0)
+        return false;
 
-    if (image_reader)
-    {
-        AImageReader_delete(image_reader);
-        image_reader = 0;
-    }
+    ACameraMetadata_const_entry e = { 0 };
+    if (ACameraMetadata_getConstEntry(camera_metadata, ACAMERA_CONTROL_AE_AVAILABLE_TARGET_FPS_RANGES, &e) != ACAMERA_OK)
+        return false;
 
-    if (image_reader_surface)
+    int best_diff = INT_MAX;
+    for (uint32_t i = 0; i + 1 < e.count; i += 2)
     {
-        ANativeWindow_release(image_reader_surface);
-        image_reader_surface = 0;
+        const int32_t lo = e.data.i32[i];
+        const int32_t hi = e.data.i32[i + 1];
+
+        const int diff = abs(lo - request_min_fps) + abs(hi - request_max_fps);
+        if (diff >= best_diff)
+            continue;
+
+        best_diff = diff;
+        fps_range[0] = lo;
+        fps_range[1] = hi;
     }
+
+    return best_diff != INT_MAX;
 }
 
 int NdkCamera::open(int _camera_facing)
@@ -217,10 +437,15 @@ int NdkCamera::open(int _camera_facing)
 
     camera_facing = _camera_facing;
 
+    capture_width = request_width;
+    capture_height = request_height;
+
     camera_manager = ACameraManager_create();
 
     // find front camera
     std::string camera_id;
+    int32_t fps_range[2] = { 0, 0 };
+    bool has_fps_range = false;
     {
         ACameraIdList* camera_id_list = 0;
         ACameraManager_getCameraIdList(camera_manager, &camera_id_list);
@@ -264,6 +489,11 @@ int NdkCamera::open(int _camera_facing)
 
             camera_orientation = orientation;
 
+            // negotiate stream size and fps range
+            choose_stream_size(camera_metadata, request_width, request_height, &capture_width, &capture_height);
+
+            has_fps_range = choose_fps_range(camera_metadata, request_min_fps, request_max_fps, fps_range);
+
             ACameraMetadata_free(camera_metadata);
 
             break;
@@ -272,7 +502,22 @@ int NdkCamera::open(int _camera_facing)
         ACameraManager_deleteCameraIdList(camera_id_list);
     }
 
-    __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "open %s %d", camera_id.c_str(), camera_orientation);
+    __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "open %s %d %dx%d fps %d-%d", camera_id.c_str(), camera_orientation, capture_width, capture_height, fps_range[0], fps_range[1]);
+
+    // setup imagereader and its surface
+    {
+        AImageReader_new(capture_width, capture_height, AIMAGE_FORMAT_YUV_420_888, request_max_images, &image_reader);
+
+        AImageReader_ImageListener listener;
+        listener.context = this;
+        listener.onImageAvailable = onImageAvailable;
+
+        AImageReader_setImageListener(image_reader, &listener);
+
+        AImageReader_getWindow(image_reader, &image_reader_surface);
+
+        ANativeWindow_acquire(image_reader_surface);
+    }
 
     // open camera
     {
@@ -284,12 +529,28 @@ int NdkCamera::open(int _camera_facing)
         ACameraManager_openCamera(camera_manager, camera_id.c_str(), &camera_device_state_callbacks, &camera_device);
     }
 
+    // consumer thread
+    {
+        // open without close, the previous consumer must be gone before its ring is reset
+        stop_consumer();
+
+        frame_ring.reset(capture_width, capture_height);
+
+        consumer_stop = false;
+        consumer = std::thread(&NdkCamera::consume_frames, this);
+    }
+
     // capture request
     {
         ACameraDevice_createCaptureRequest(camera_device, TEMPLATE_PREVIEW, &capture_request);
 
         ACameraOutputTarget_create(image_reader_surface, &image_reader_target);
         ACaptureRequest_addTarget(capture_request, image_reader_target);
+
+        if (has_fps_range)
+        {
+            ACaptureRequest_setEntry_i32(capture_request, ACAMERA_CONTROL_AE_TARGET_FPS_RANGE, 2, fps_range);
+        }
     }
 
     // capture session
@@ -341,6 +602,10 @@ void NdkCamera::close()
         camera_device = 0;
     }
 
+    stop_consumer();
+
+    frame_buffers.clear();
+
     if (capture_session_output_container)
     {
         ACaptureSessionOutputContainer_free(capture_session_output_container);
@@ -365,6 +630,18 @@ void NdkCamera::close()
         image_reader_target = 0;
     }
 
+    if (image_reader)
+    {
+        AImageReader_delete(image_reader);
+        image_reader = 0;
+    }
+
+    if (image_reader_surface)
+    {
+        ANativeWindow_release(image_reader_surface);
+        image_reader_surface = 0;
+    }
+
     if (camera_manager)
     {
         ACameraManager_delete(camera_manager);
@@ -372,6 +649,34 @@ void NdkCamera::close()
     }
 }
 
+void NdkCamera::stop_consumer()
+{
+    if (!consumer.joinable())
+        return;
+
+    consumer_stop = true;
+    frame_ring.wake();
+    consumer.join();
+
+    __android_log_print(ANDROID_LOG_WARN, "NdkCamera", "frames %d dropped %d", frame_ring.received(), frame_ring.dropped());
+}
+
+void NdkCamera::consume_frames()
+{
+    while (!consumer_stop)
+    {
+        int nv21_width = 0;
+        int nv21_height = 0;
+        const unsigned char* nv21 = frame_ring.begin_read(&nv21_width, &nv21_height);
+        if (!nv21)
+            continue;
+
+        on_image(nv21, nv21_width, nv21_height);
+
+        frame_ring.end_read();
+    }
+}
+
 void NdkCamera::on_image(const cv::Mat& rgb) const
 {
 }
@@ -409,11 +714,11 @@ void NdkCamera::on_image(const unsigned char* nv21, int nv21_width, int nv21_hei
         }
     }
 
-    cv::Mat nv21_rotated(h + h / 2, w, CV_8UC1);
+    cv::Mat& nv21_rotated = frame_buffers.get(FrameBufferPool::NV21_ROTATED, h + h / 2, w, CV_8UC1);
     ncnn::kanna_rotate_yuv420sp(nv21, nv21_width, nv21_height, nv21_rotated.data, w, h, rotate_type);
 
     // nv21_rotated to rgb
-    cv::Mat rgb(h, w, CV_8UC3);
+    cv::Mat& rgb = frame_buffers.get(FrameBufferPool::RGB, h, w, CV_8UC3);
     ncnn::yuv420sp2rgb(nv21_rotated.data, w, h, rgb.data);
 
     on_image(rgb);
@@ -424,30 +729,42 @@ static const int NDKCAMERAWINDOW_ID = 233;
 NdkCameraWindow::NdkCameraWindow() : NdkCamera()
 {
     sensor_manager = 0;
-    sensor_event_queue = 0;
     accelerometer_sensor = 0;
     win = 0;
+    sensor_frame_inference = false;
 
     accelerometer_orientation = 0;
+    sensor_stop = false;
+    sensor_looper = 0;
 
     // sensor
     sensor_manager = ASensorManager_getInstance();
 
     accelerometer_sensor = ASensorManager_getDefaultSensor(sensor_manager, ASENSOR_TYPE_ACCELEROMETER);
-}
 
-NdkCameraWindow::~NdkCameraWindow()
-{
     if (accelerometer_sensor)
     {
-        ASensorEventQueue_disableSensor(sensor_event_queue, accelerometer_sensor);
-        accelerometer_sensor = 0;
+        sensor_thread = std::thread(&NdkCameraWindow::track_orientation, this);
     }
+}
 
-    if (sensor_event_queue)
+NdkCameraWindow::~NdkCameraWindow()
+{
+    // ~NdkCamera closes too late, the consumer would call into an already destroyed window
+    stop_consumer();
+
+    if (sensor_thread.joinable())
     {
-        ASensorManager_destroyEventQueue(sensor_manager, sensor_event_queue);
-        sensor_event_queue = 0;
+        // either the thread sees the flag or we see its looper to wake
+        sensor_stop = true;
+
+        ALooper* looper = sensor_looper;
+        if (looper)
+        {
+            ALooper_wake(looper);
+        }
+
+        sensor_thread.join();
     }
 
     if (win)
@@ -456,71 +773,121 @@ NdkCameraWindow::~NdkCameraWindow()
     }
 }
 
-void NdkCameraWindow::set_window(ANativeWindow* _win)
+// accelerometer reading to device orientation, -1 inside the dead zone
+static int acceleration_to_orientation(const ASensorEvent& e)
 {
-    if (win)
+    float acceleration_x = e.acceleration.x;
+    float acceleration_y = e.acceleration.y;
+//     __android_log_print(ANDROID_LOG_WARN, "NdkCameraWindow", "x = %f, y = %f", acceleration_x, acceleration_y);
+
+    int orientation = -1;
+    if (acceleration_y > 7)
     {
-        ANativeWindow_release(win);
+        orientation = 0;
+    }
+    if (acceleration_x < -7)
+    {
+        orientation = 90;
+    }
+    if (acceleration_y < -7)
+    {
+        orientation = 180;
+    }
+    if (acceleration_x > 7)
+    {
+        orientation = 270;
     }
 
-    win = _win;
-    ANativeWindow_acquire(win);
+    return orientation;
 }
 
-void NdkCameraWindow::on_image_render(cv::Mat& rgb) const
+void NdkCameraWindow::track_orientation()
 {
-}
+    ALooper* looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
 
-void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
-{
-    // resolve orientation from camera_orientation and accelerometer_sensor
-    {
-        if (!sensor_event_queue)
-        {
-            sensor_event_queue = ASensorManager_createEventQueue(sensor_manager, ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS), NDKCAMERAWINDOW_ID, 0, 0);
+    ASensorEventQueue* sensor_event_queue = ASensorManager_createEventQueue(sensor_manager, looper, NDKCAMERAWINDOW_ID, 0, 0);
 
-            ASensorEventQueue_enableSensor(sensor_event_queue, accelerometer_sensor);
-        }
+    ASensorEventQueue_enableSensor(sensor_event_queue, accelerometer_sensor);
 
-        int id = ALooper_pollAll(0, 0, 0, 0);
-        if (id == NDKCAMERAWINDOW_ID)
-        {
-            ASensorEvent e[8];
-            ssize_t num_event = 0;
-            while (ASensorEventQueue_hasEvents(sensor_event_queue) == 1)
-            {
-                num_event = ASensorEventQueue_getEvents(sensor_event_queue, e, 8);
-                if (num_event < 0)
-                    break;
-            }
+    // orientation changes a few times per minute at most, 10 events per second are plenty
+    ASensorEventQueue_setEventRate(sensor_event_queue, accelerometer_sensor, 100000);
+
+    sensor_looper = looper;
+
+    // a new orientation has to hold for a few consecutive events before it is published
+    const int hysteresis_events = 3;
+
+    int candidate = accelerometer_orientation;
+    int candidate_count = 0;
+
+    while (!sensor_stop)
+    {
+        int id = ALooper_pollOnce(-1, 0, 0, 0);
+        if (id != NDKCAMERAWINDOW_ID)
+            continue;
 
-            if (num_event > 0)
+        ASensorEvent e[8];
+        ssize_t num_event = 0;
+        while ((num_event = ASensorEventQueue_getEvents(sensor_event_queue, e, 8)) > 0)
+        {
+            for (ssize_t i = 0; i < num_event; i++)
             {
-                float acceleration_x = e[num_event - 1].acceleration.x;
-                float acceleration_y = e[num_event - 1].acceleration.y;
-                float acceleration_z = e[num_event - 1].acceleration.z;
-//                 __android_log_print(ANDROID_LOG_WARN, "NdkCameraWindow", "x = %f, y = %f, z = %f", x, y, z);
+                const int orientation = acceleration_to_orientation(e[i]);
+                if (orientation < 0)
+                    continue;
 
-                if (acceleration_y > 7)
-                {
-                    accelerometer_orientation = 0;
-                }
-                if (acceleration_x < -7)
+                if (orientation == candidate)
                 {
-                    accelerometer_orientation = 90;
+                    candidate_count++;
                 }
-                if (acceleration_y < -7)
+                else
                 {
-                    accelerometer_orientation = 180;
+                    candidate = orientation;
+                    candidate_count = 1;
                 }
-                if (acceleration_x > 7)
+
+                if (candidate_count >= hysteresis_events && candidate != accelerometer_orientation)
                 {
-                    accelerometer_orientation = 270;
+                    accelerometer_orientation = candidate;
                 }
             }
         }
     }
 
+    ASensorEventQueue_disableSensor(sensor_event_queue, accelerometer_sensor);
+
+    ASensorManager_destroyEventQueue(sensor_manager, sensor_event_queue);
+}
+
+void NdkCameraWindow::set_window(ANativeWindow* _win)
+{
+    if (win)
+    {
+        ANativeWindow_release(win);
+    }
+
+    win = _win;
+    ANativeWindow_acquire(win);
+}
+
+void NdkCameraWindow::set_sensor_frame_inference(bool enable)
+{
+    sensor_frame_inference = enable;
+}
+
+void NdkCameraWindow::on_image_detect(const unsigned char* nv21, int nv21_width, int nv21_height, const cv::Rect& roi, int rotate_type) const
+{
+}
+
+void NdkCameraWindow::on_image_render(cv::Mat& rgb) const
+{
+}
+
+void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const
+{
+    // orientation is tracked on the sensor thread, take one snapshot for the whole frame
+    const int accelerometer_orientation = this->accelerometer_orientation;
+
     // roi crop and rotate nv21
     int nv21_roi_x = 0;
     int nv21_roi_y = 0;
@@ -703,8 +1070,14 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
         }
     }
 
+    if (sensor_frame_inference)
+    {
+        // inference samples the camera frame itself, nothing gets converted for it here
+        on_image_detect(nv21, nv21_width, nv21_height, cv::Rect(nv21_roi_x, nv21_roi_y, nv21_roi_w, nv21_roi_h), rotate_type);
+    }
+
     // crop and rotate nv21
-    cv::Mat nv21_croprotated(roi_h + roi_h / 2, roi_w, CV_8UC1);
+    cv::Mat& nv21_croprotated = frame_buffers.get(FrameBufferPool::NV21_ROTATED, roi_h + roi_h / 2, roi_w, CV_8UC1);
     {
         const unsigned char* srcY = nv21 + nv21_roi_y * nv21_width + nv21_roi_x;
         unsigned char* dstY = nv21_croprotated.data;
@@ -716,14 +1089,20 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
     }
 
     // nv21_croprotated to rgb
-    cv::Mat rgb(roi_h, roi_w, CV_8UC3);
+    cv::Mat& rgb = frame_buffers.get(FrameBufferPool::RGB, roi_h, roi_w, CV_8UC3);
     ncnn::yuv420sp2rgb(nv21_croprotated.data, roi_w, roi_h, rgb.data);
 
     on_image_render(rgb);
 
     // rotate to native window orientation
-    cv::Mat rgb_render(render_h, render_w, CV_8UC3);
-    ncnn::kanna_rotate_c3(rgb.data, roi_w, roi_h, rgb_render.data, render_w, render_h, render_rotate_type);
+    // the nv21 rotate already made the frame upright, held in portrait that is the window orientation too
+    const cv::Mat* rgb_render = &rgb;
+    if (render_rotate_type != 1)
+    {
+        cv::Mat& rgb_rotated = frame_buffers.get(FrameBufferPool::RGB_RENDER, render_h, render_w, CV_8UC3);
+        ncnn::kanna_rotate_c3(rgb.data, roi_w, roi_h, rgb_rotated.data, render_w, render_h, render_rotate_type);
+        rgb_render = &rgb_rotated;
+    }
 
     ANativeWindow_setBuffersGeometry(win, render_w, render_h, AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM);
 
@@ -735,7 +1114,7 @@ void NdkCameraWindow::on_image(const unsigned char* nv21, int nv21_width, int nv
     {
         for (int y = 0; y < render_h; y++)
         {
-            const unsigned char* ptr = rgb_render.ptr<const unsigned char>(y);
+            const unsigned char* ptr = rgb_render->ptr<const unsigned char>(y);
             unsigned char* outptr = (unsigned char*)buf.bits + buf.stride * 4 * y;
 
             int x = 0;
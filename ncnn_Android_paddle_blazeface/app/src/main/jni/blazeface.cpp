@@ -20,185 +20,10 @@
 
 #include "cpu.h"
 
-static inline float intersection_area(const FaceObject& a, const FaceObject& b)
-{
-    cv::Rect_<float> inter = a.rect & b.rect;
-    return inter.area();
-}
-
-static void qsort_descent_inplace(std::vector<FaceObject>& faceobjects, int left, int right)
-{
-    int i = left;
-    int j = right;
-    float p = faceobjects[(left + right) / 2].prob;
-
-    while (i <= j)
-    {
-        while (faceobjects[i].prob > p)
-            i++;
-
-        while (faceobjects[j].prob < p)
-            j--;
-
-        if (i <= j)
-        {
-            // swap
-            std::swap(faceobjects[i], faceobjects[j]);
-
-            i++;
-            j--;
-        }
-    }
-
-//     #pragma omp parallel sections
-    {
-//         #pragma omp section
-        {
-            if (left < j) qsort_descent_inplace(faceobjects, left, j);
-        }
-//         #pragma omp section
-        {
-            if (i < right) qsort_descent_inplace(faceobjects, i, right);
-        }
-    }
-}
-
-static void qsort_descent_inplace(std::vector<FaceObject>& faceobjects)
-{
-    if (faceobjects.empty())
-        return;
-
-    qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
-}
-
-static void nms_sorted_bboxes(const std::vector<FaceObject>& faceobjects, std::vector<int>& picked, float nms_threshold)
-{
-    picked.clear();
-
-    const int n = faceobjects.size();
-
-    std::vector<float> areas(n);
-    for (int i = 0; i < n; i++)
-    {
-        areas[i] = faceobjects[i].rect.area();
-    }
-
-    for (int i = 0; i < n; i++)
-    {
-        const FaceObject& a = faceobjects[i];
-
-        int keep = 1;
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            const FaceObject& b = faceobjects[picked[j]];
-
-            // intersection over union
-            float inter_area = intersection_area(a, b);
-            float union_area = areas[i] + areas[picked[j]] - inter_area;
-            //             float IoU = inter_area / union_area
-            if (inter_area / union_area > nms_threshold)
-                keep = 0;
-        }
-
-        if (keep)
-            picked.push_back(i);
-    }
-}
-
-int BlazeFace::generate_anchors(int target_size,int step_size,std::vector<float> min_sizes,std::vector<float> aspect_ratios,float offset,std::vector<float> variances)
-{
-	int image_w = target_size;
-	int image_h = target_size;
-
-	float step_w = step_size;
-	float step_h = step_size;
-    int feat_size = target_size / step_size;
-
-	int num_min_size = min_sizes.size();
-	int num_aspect_ratio = aspect_ratios.size();
-
-	for (int i = 0; i < feat_size; i++)
-	{
-		float center_x = offset * step_w;
-		float center_y = offset * step_h + i * step_h;
-
-		for (int j = 0; j < feat_size; j++)
-		{
-			float box_w;
-			float box_h;
-
-			for (int k = 0; k < num_min_size; k++)
-			{
-				float min_size = min_sizes[k];
-				box_w = min_size;
-                box_h = min_size;
-                for (int p = 0; p < num_aspect_ratio; p++)
-				{
-					float ar = aspect_ratios[p];
-
-					box_w = static_cast<float>(min_size * sqrt(ar));
-					box_h = static_cast<float>(min_size / sqrt(ar));
-
-					float box0 = (center_x - box_w * 0.5f) / image_w;
-					float box1 = (center_y - box_h * 0.5f) / image_h;
-					float box2 = (center_x + box_w * 0.5f) / image_w;
-					float box3 = (center_y + box_h * 0.5f) / image_h;
-
-					float pb_w = box2 - box0;
-					float pb_h = box3 - box1;
-					float pb_x = box0 + pb_w * 0.5;
-					float pb_y = box1 + pb_h * 0.5;
-
-					anchors.push_back(std::vector<float>{pb_x, pb_y, pb_w, pb_h});
-				}
-			}
-			center_x += step_w;
-		}
-	}
-
-	return 0;
-}
-void BlazeFace::generate_proposals(const ncnn::Mat& score_blob, const ncnn::Mat& bbox_blob, float score_threshold, int num_anchors,int target_size,std::vector<FaceObject> &faceobjects)
-{
-	const float* score_data = (float*)score_blob.data;
-	const float* bbox_data = (float*)bbox_blob.data;
-    for (int i = 0; i < num_anchors; i++)
-	{
-        if (score_data[i * 2 + 0] > score_threshold)
-		{
-			FaceObject obj;
-			float pb_w = anchors[i][2];
-			float pb_h = anchors[i][3];
-			float pb_x = anchors[i][0];
-			float pb_y = anchors[i][1];
-
-			float x_center = pb_x + bbox_data[i * 4 + 0] * pb_w * 0.1;
-			float y_center = pb_y + bbox_data[i * 4 + 1] * pb_h * 0.1;
-			float w = exp(bbox_data[i * 4 + 2] * 0.2) * pb_w;
-			float h = exp(bbox_data[i * 4 + 3] * 0.2) * pb_h;
-
-            float x1 = std::max(std::min((float)(x_center - w / 2.0), 1.f), 0.f) * target_size;
-            float y1 = std::max(std::min((float)(y_center - h / 2.0), 1.f), 0.f) * target_size;
-            float x2 = std::max(std::min((float)(x_center + w / 2.0), 1.f), 0.f) * target_size;
-            float y2 = std::max(std::min((float)(y_center + h / 2.0), 1.f), 0.f) * target_size;
-            float prob = std::max(std::min((float)score_data[i * 2 + 0], 1.f), 0.f);
-
-            obj.rect = cv::Rect2f(x1, y1, x2 - x1, y2 - y1);
-            obj.prob = prob;
-
-            faceobjects.push_back(obj);
-        }
-    }
-}
-
-
 int BlazeFace::load(AAssetManager* mgr, int _target_size, bool use_gpu)
 {
     blazeface.clear();
 
-    ncnn::set_cpu_powersave(2);
-    ncnn::set_omp_num_threads(ncnn::get_big_cpu_count());
-
     blazeface.opt = ncnn::Option();
 
 #if NCNN_VULKAN
@@ -212,12 +37,6 @@ int BlazeFace::load(AAssetManager* mgr, int _target_size, bool use_gpu)
 
     target_size = _target_size;
 
-    anchors.clear();
-	for (int i = 0; i < steps.size(); i++)
-	{
-		generate_anchors(target_size, steps[i], min_sizes[i],  aspect_ratios[i], offset, variances);
-	}
-
     return 0;
 }
 
@@ -226,77 +45,45 @@ int BlazeFace::detect(const cv::Mat& rgb, std::vector<FaceObject>& faceobjects,
     int width = rgb.cols;
     int height = rgb.rows;
 
-    // pad to multiple of 32
-    int w = width;
-    int h = height;
-    float scale = 1.f;
-    if (w > h)
-    {
-        scale = (float)target_size / w;
-        w = target_size;
-        h = h * scale;
-    }
-    else
-    {
-        scale = (float)target_size / h;
-        h = target_size;
-        w = w * scale;
-    }
+    // long side to target_size, keep the aspect ratio
+    int w;
+    int h;
+    float scale = letterbox_scale(width, height, target_size, w, h);
 
     ncnn::Mat in = ncnn::Mat::from_pixels_resize(rgb.data, ncnn::Mat::PIXEL_RGB, width, height, w, h);
 
-    // pad to target_size rectangle
-    int wpad = target_size - w;
-    int hpad = target_size - h;
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 0.f);
-
-    in_pad.substract_mean_normalize(mean_vals, norm_vals);
+    in.substract_mean_normalize(backend.mean_values(), backend.norm_values());
 
     ncnn::Extractor ex = blazeface.create_extractor();
+    policy.apply(ex);
 
-    ex.input("image", in_pad);
-
-	ncnn::Mat scores;
-	ncnn::Mat boxes;
-	ex.extract("scores", scores);
-	ex.extract("boxes", boxes);
-
-    std::vector<FaceObject> faceproposals;
-    generate_proposals(scores,boxes,prob_threshold,anchors.size(),target_size,faceproposals);
-    // sort all proposals by score from highest to lowest
-    qsort_descent_inplace(faceproposals);
+    // padded to a multiple of 16 only, a 4:3 frame runs on a 4:3 input
+    std::vector<DetectorProposal> faces;
+    detect_faces(backend, ex, in, scale, width, height, prob_threshold, nms_threshold, weighted_nms, max_faces, scratch, faces);
 
-    // apply nms with nms_threshold
-    std::vector<int> picked;
-    nms_sorted_bboxes(faceproposals, picked, nms_threshold);
-
-    int face_count = picked.size();
-
-    faceobjects.resize(face_count);
-    for (int i = 0; i < face_count; i++)
+    faceobjects.resize(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
     {
-        faceobjects[i] = faceproposals[picked[i]];
-
-        // adjust offset to original unpadded
-        float x0 = (faceobjects[i].rect.x - (wpad / 2)) / scale;
-        float y0 = (faceobjects[i].rect.y - (hpad / 2)) / scale;
-        float x1 = (faceobjects[i].rect.x + faceobjects[i].rect.width - (wpad / 2)) / scale;
-        float y1 = (faceobjects[i].rect.y + faceobjects[i].rect.height - (hpad / 2)) / scale;
+        faceobjects[i].rect = faces[i].rect;
+        faceobjects[i].prob = faces[i].prob;
+    }
 
-        x0 = std::max(std::min(x0, (float)width - 1), 0.f);
-        y0 = std::max(std::min(y0, (float)height - 1), 0.f);
-        x1 = std::max(std::min(x1, (float)width - 1), 0.f);
-        y1 = std::max(std::min(y1, (float)height - 1), 0.f);
+    return 0;
+}
 
-        faceobjects[i].rect.x = x0;
-        faceobjects[i].rect.y = y0;
-        faceobjects[i].rect.width = x1 - x0;
-        faceobjects[i].rect.height = y1 - y0;
+void BlazeFace::set_policy(const StagePolicy& _policy)
+{
+    policy = _policy;
+}
 
-    }
+void BlazeFace::set_max_faces(int count)
+{
+    max_faces = count;
+}
 
-    return 0;
+void BlazeFace::set_weighted_nms(bool enable)
+{
+    weighted_nms = enable;
 }
 
 int BlazeFace::draw(cv::Mat& rgb, const std::vector<FaceObject>& faceobjects)
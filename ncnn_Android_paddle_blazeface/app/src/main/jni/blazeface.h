@@ -19,6 +19,10 @@
 
 #include <net.h>
 
+#include "ssddetector.h"
+#include "stagepolicy.h"
+
+// the model has score and box heads only, no keypoints
 struct FaceObject
 {
     cv::Rect_<float> rect;
@@ -33,25 +37,25 @@ public:
     int detect(const cv::Mat& rgb, std::vector<FaceObject>& faceobjects, float prob_threshold = 0.8f, float nms_threshold = 0.3f);
 
     int draw(cv::Mat& rgb, const std::vector<FaceObject>& faceobjects);
+
+    void set_policy(const StagePolicy& policy);
+
+    // keep at most count faces after nms, 0 for no limit
+    void set_max_faces(int count);
+
+    // blend overlapping detections by score instead of dropping them, steadier boxes
+    void set_weighted_nms(bool enable);
 private:
-    int generate_anchors(int target_size,int step_size,std::vector<float> min_sizes,std::vector<float> aspect_ratios,float offset,std::vector<float> variances);
-	void generate_proposals(const ncnn::Mat& score_blob, const ncnn::Mat& bbox_blob, float score_threshold, int num_anchors,int target_size,std::vector<FaceObject> &faceobjects);
-    const float mean_vals[3] = {123.675f, 116.28f, 103.53f};
-    const float norm_vals[3] = {0.017125f, 0.017507f, 0.017429f};
-    const std::vector<std::vector<float>> min_sizes = {
-			std::vector<float>{16.0,24.0},
-			std::vector<float>{32.0,48.0,64.0,80.0,96.0,128.0}};
-	const std::vector<std::vector<float>> aspect_ratios{
-			std::vector<float>{1.0},
-			std::vector<float>{1.0}};
-	const std::vector<int> steps = { 8, 16 };
-	const float offset = 0.5f;
-	const std::vector<float> variances = { 0.1,0.1,0.2,0.2 };
-    std::vector<std::vector<float>> anchors = {};
+    // anchors, normalization and decoding of the net, the shared detector stages run around it
+    SsdDetectorBackend backend;
+    // decode and nms vectors reused across frames, detect runs under the caller's lock
+    DetectorScratch scratch;
     int target_size;
 private:
     ncnn::Net blazeface;
-    bool has_kps;
+    StagePolicy policy;
+    int max_faces = 0;
+    bool weighted_nms = false;
 };
 
 #endif // BLAZEFACE_H
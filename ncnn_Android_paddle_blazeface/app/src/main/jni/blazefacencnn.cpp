@@ -143,6 +143,29 @@ void MyNdkCamera::on_image_render(cv::Mat& rgb) const
 
 static MyNdkCamera* g_camera = 0;
 
+// detector input of the last loadModel, picks the capture size on the next openCamera
+static int g_target_size = 128;
+
+// smallest 4:3 stream leaving some headroom over the detector input, the camera picks the nearest it supports
+static void capture_size_for_target(int target_size, int* width, int* height)
+{
+    if (target_size * 3 / 2 <= 240)
+    {
+        *width = 320;
+        *height = 240;
+    }
+    else if (target_size * 3 / 2 <= 480)
+    {
+        *width = 640;
+        *height = 480;
+    }
+    else
+    {
+        *width = 1280;
+        *height = 960;
+    }
+}
+
 extern "C" {
 
 JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved)
@@ -192,6 +215,8 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_blazefacencnn_BlazeFaceNcnn_loadMode
     int target_size = target_sizes[(int)modelid];
     bool use_gpu = (int)cpugpu == 1;
 
+    g_target_size = target_size;
+
     // reload
     {
         ncnn::MutexLockGuard g(lock);
@@ -219,8 +244,13 @@ JNIEXPORT jboolean JNICALL Java_com_tencent_blazefacencnn_BlazeFaceNcnn_openCame
     if (facing < 0 || facing > 1)
         return JNI_FALSE;
 
-    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "openCamera %d", facing);
+    int capture_width = 640;
+    int capture_height = 480;
+    capture_size_for_target(g_target_size, &capture_width, &capture_height);
+
+    __android_log_print(ANDROID_LOG_DEBUG, "ncnn", "openCamera %d %dx%d", facing, capture_width, capture_height);
 
+    g_camera->set_capture_config(capture_width, capture_height);
     g_camera->open((int)facing);
 
     return JNI_TRUE;
@@ -23,14 +23,106 @@
 #include <camera/NdkCameraMetadata.h>
 #include <media/NdkImageReader.h>
 
+#include <semaphore.h>
+
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
 #include <opencv2/core/core.hpp>
 
+// preallocated nv21 slots passed from the camera callback to the inference thread without locks
+//
+// single producer, single consumer, the consumer always takes the newest frame
+// and the frames it skips are counted as dropped
+class FrameRing
+{
+public:
+    FrameRing();
+    ~FrameRing();
+
+    // reallocate slots and counters, only while neither side is running
+    void reset(int width, int height);
+
+    // producer, returns 0 when every slot is still pending and the frame has to be dropped
+    unsigned char* begin_write(int width, int height);
+    void end_write();
+
+    // consumer, blocks until a frame is published, returns 0 when woken up without one
+    const unsigned char* begin_read(int* width, int* height);
+    void end_read();
+    void wake();
+
+    int received() const { return received_count.load(); }
+    int dropped() const { return dropped_count.load(); }
+
+private:
+    enum { SLOT_COUNT = 3 };
+
+    struct Slot
+    {
+        std::vector<unsigned char> nv21;
+        int width;
+        int height;
+    };
+
+    Slot slots[SLOT_COUNT];
+
+    // monotonic counters, slot index is counter % SLOT_COUNT
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+    unsigned int reading;
+
+    std::atomic<int> received_count;
+    std::atomic<int> dropped_count;
+
+    sem_t available;
+};
+
+// frame sized conversion buffers recycled across frames
+//
+// keyed by purpose and geometry, a buffer is only allocated the first time a
+// window size or orientation shows up and reused for every frame after that
+class FrameBufferPool
+{
+public:
+    enum
+    {
+        NV21_ROTATED = 0,
+        RGB = 1,
+        RGB_RENDER = 2
+    };
+
+    // the returned mat stays valid until clear() or the next get() with the same key
+    cv::Mat& get(int tag, int rows, int cols, int type);
+
+    void clear();
+
+private:
+    struct Key
+    {
+        int tag;
+        int rows;
+        int cols;
+        int type;
+
+        bool operator<(const Key& k) const;
+    };
+
+    std::map<Key, cv::Mat> buffers;
+};
+
 class NdkCamera
 {
 public:
     NdkCamera();
     virtual ~NdkCamera();
 
+    // requested capture size, reader queue depth and ae fps range, applied on the next open
+    // the size is matched against the yuv streams the camera reports, fps 0 keeps the template default
+    void set_capture_config(int width, int height, int max_images = 2, int min_fps = 0, int max_fps = 0);
+
     // facing 0=front 1=back
     int open(int camera_facing = 0);
     void close();
@@ -43,7 +135,32 @@ public:
     int camera_facing;
     int camera_orientation;
 
+    // negotiated stream size of the opened camera
+    int capture_width;
+    int capture_height;
+
+    // filled by the image reader callback, drained by the consumer thread
+    FrameRing frame_ring;
+
+protected:
+    // only touched from the consumer thread
+    mutable FrameBufferPool frame_buffers;
+
+    // join the consumer so no on_image call outlives the caller's state
+    void stop_consumer();
+
 private:
+    void consume_frames();
+
+    std::thread consumer;
+    std::atomic<bool> consumer_stop;
+
+    int request_width;
+    int request_height;
+    int request_max_images;
+    int request_min_fps;
+    int request_max_fps;
+
     ACameraManager* camera_manager;
     ACameraDevice* camera_device;
     AImageReader* image_reader;
@@ -63,18 +180,31 @@ public:
 
     void set_window(ANativeWindow* win);
 
+    // hand on_image_detect the camera nv21 as is, only the display path crops, rotates and converts
+    void set_sensor_frame_inference(bool enable);
+
+    // sensor frame inference, roi is the part shown in the window and rotate_type
+    // the ncnn::kanna_rotate type that brings it upright
+    virtual void on_image_detect(const unsigned char* nv21, int nv21_width, int nv21_height, const cv::Rect& roi, int rotate_type) const;
+
     virtual void on_image_render(cv::Mat& rgb) const;
 
     virtual void on_image(const unsigned char* nv21, int nv21_width, int nv21_height) const;
 
 public:
-    mutable int accelerometer_orientation;
+    // published by the sensor thread, read once per frame
+    std::atomic<int> accelerometer_orientation;
 
 private:
+    void track_orientation();
+
     ASensorManager* sensor_manager;
-    mutable ASensorEventQueue* sensor_event_queue;
     const ASensor* accelerometer_sensor;
+    std::thread sensor_thread;
+    std::atomic<bool> sensor_stop;
+    std::atomic<ALooper*> sensor_looper;
     ANativeWindow* win;
+    bool sensor_frame_inference;
 };
 
 #endif // NDKCAMERA_H